@@ -0,0 +1,160 @@
+#include "access_patterns.h"
+#include <algorithm>
+#include "../common/data_generation.h"
+#include "../common/options.h"
+#include "../instrumentation/tracing.h"
+
+#define NUM_32BIT_INTS_IN_CACHE_LINE (64 * 8 / 32)
+#define RANDOM_INDEX_ARRAY_ADDITION_RANGE_IN_ELEMENTS_MAX NUM_32BIT_INTS_IN_CACHE_LINE * 1024 * 1024 * 16 // 256 is where it appears to be even with the prefetching
+#define RANDOM_STRIDE_DISTANCE 16348 * 2 * 2 * 2 * 2 * 2 * 2
+
+const std::vector<access_patterns::Pattern> &access_patterns::all() {
+    static const std::vector<Pattern> patterns = {
+            Pattern::Sequential,
+            Pattern::Shuffled,
+            Pattern::PartiallySorted,
+            Pattern::ClusteredUnsorted,
+            Pattern::BoundedRandomOffset,
+            Pattern::RandomWalk,
+    };
+    return patterns;
+}
+
+const char *access_patterns::name(Pattern pattern) {
+    switch (pattern) {
+        case Pattern::Sequential:
+            return "sequential";
+        case Pattern::Shuffled:
+            return "shuffled";
+        case Pattern::PartiallySorted:
+            return "partially_sorted";
+        case Pattern::ClusteredUnsorted:
+            return "clustered_unsorted";
+        case Pattern::BoundedRandomOffset:
+            return "bounded_random_offset";
+        case Pattern::RandomWalk:
+            return "random_walk";
+    }
+    return "unknown";
+}
+
+bool access_patterns::from_name(const std::string &name, Pattern *pattern) {
+    for (auto candidate : all()) {
+        if (name == access_patterns::name(candidate)) {
+            *pattern = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool access_patterns::has_parameter(Pattern pattern) {
+    return pattern != Pattern::Sequential && pattern != Pattern::Shuffled;
+}
+
+const char *access_patterns::parameter_name(Pattern pattern) {
+    switch (pattern) {
+        case Pattern::PartiallySorted:
+        case Pattern::ClusteredUnsorted:
+            return "sortedness";
+        case Pattern::BoundedRandomOffset:
+            return "max_offset";
+        case Pattern::RandomWalk:
+            return "max_stride";
+        default:
+            return "";
+    }
+}
+
+std::vector<int64_t> access_patterns::default_grid(Pattern pattern) {
+    std::vector<int64_t> grid;
+    switch (pattern) {
+        case Pattern::PartiallySorted:
+        case Pattern::ClusteredUnsorted:
+            for (int x = 0; x <= 100; x += 10) {
+                grid.push_back(x);
+            }
+            break;
+        case Pattern::BoundedRandomOffset:
+            for (int64_t x = 1; x < RANDOM_INDEX_ARRAY_ADDITION_RANGE_IN_ELEMENTS_MAX; x *= 2) {
+                grid.push_back(x);
+            }
+            break;
+        case Pattern::RandomWalk:
+            grid.push_back(RANDOM_STRIDE_DISTANCE);
+            break;
+        default:
+            break;
+    }
+    return grid;
+}
+
+std::vector<int64_t> access_patterns::grid(Pattern pattern) {
+    return options::get_int_list(std::string(name(pattern)) + "_grid", default_grid(pattern));
+}
+
+// Keeps a generated index inside the data array, the last valid element is num_elements - 1
+static int32_t clamp_index(int64_t index, int64_t num_elements) {
+    return (int32_t) std::min(num_elements - 1, std::max((int64_t) 0, index));
+}
+
+void access_patterns::generate(Pattern pattern, int32_t *index_array, int64_t num_elements, int64_t parameter) {
+    const tracing::Scope scope(name(pattern), "setup");
+    const data_generation::Random random(data_generation::Stream::Indexes, (uint64_t) pattern);
+
+    switch (pattern) {
+        case Pattern::Sequential:
+            data_generation::parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+                for (int64_t x = begin; x < end; x++) {
+                    index_array[x] = (int32_t) x;
+                }
+            });
+            break;
+        case Pattern::Shuffled:
+            data_generation::fill_permutation(index_array, num_elements, random);
+            break;
+        case Pattern::PartiallySorted: {
+            double unsortedness = (100 - (double) parameter) / 100;
+            data_generation::parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+                for (int64_t x = begin; x < end; x++) {
+                    index_array[x] = random.chance(2 * x, unsortedness)
+                                     ? (int32_t) random.below(2 * x + 1, num_elements) : (int32_t) x;
+                }
+            });
+            break;
+        }
+        case Pattern::ClusteredUnsorted: {
+            int unsortedness = 100 - (int) parameter;
+            data_generation::parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+                for (int64_t x = begin; x < end; x++) {
+                    index_array[x] = x % 100 < unsortedness ? (int32_t) random.below(x, num_elements) : (int32_t) x;
+                }
+            });
+            break;
+        }
+        case Pattern::BoundedRandomOffset: {
+            uint64_t offset = parameter + 1;
+            data_generation::parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+                for (int64_t x = begin; x < end; x++) {
+                    int64_t amount_to_add = (int64_t) random.below(2 * x, offset)
+                                            - (int64_t) random.below(2 * x + 1, offset);
+                    index_array[x] = clamp_index(x + amount_to_add, num_elements);
+                }
+            });
+            break;
+        }
+        case Pattern::RandomWalk: {
+            // Deal with the first array element, set it to 0 because one element will not have an effect on the
+            // run time of the huge array
+            // Clamping at the ends makes every step depend on the last one, so this is the only sequential pattern
+            index_array[0] = 0;
+            uint64_t offset = parameter + 1;
+            for (int64_t x = 1; x < num_elements; x++) {
+                int64_t amount_to_add = (int64_t) random.below(2 * x, offset)
+                                        - (int64_t) random.below(2 * x + 1, offset);
+                index_array[x] = clamp_index(index_array[x - 1] + amount_to_add, num_elements);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_ACCESS_PATTERNS_H
+#define OPTIMIZATION_TESTING_GROUND_ACCESS_PATTERNS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Index array generators for the indirect access benchmarks.
+ * Each pattern fills index_array[0..num_elements) with indexes in [0, num_elements) and takes at most one parameter,
+ * which is swept as the second benchmark argument. These used to be the TESTING_SORTEDNESS, SORTEDNESS_CLUSTERED,
+ * RANDOM_INDEX_ARRAY_ADDITION and RANDOM_STRIDE_FROM_PREVIOUS switches in prefetching.cpp.
+ */
+namespace access_patterns {
+    enum class Pattern {
+        Sequential,          // index_array[x] = x
+        Shuffled,            // A random permutation of 0..num_elements
+        PartiallySorted,     // Parameter: sortedness (%), each element is replaced by a random index with 100 - p % chance
+        ClusteredUnsorted,   // Parameter: sortedness (%), the first 100 - p elements out of every 100 are random
+        BoundedRandomOffset, // Parameter: max offset, index_array[x] = x + U[0, p] - U[0, p]
+        RandomWalk,          // Parameter: max stride, index_array[x] = index_array[x - 1] + U[0, p] - U[0, p]
+    };
+
+    const std::vector<Pattern> &all();
+    const char *name(Pattern pattern);
+    bool from_name(const std::string &name, Pattern *pattern);
+    bool has_parameter(Pattern pattern);
+    const char *parameter_name(Pattern pattern);
+
+    // The parameter sweep a pattern runs with, overridable at runtime with --<pattern name>_grid=a,b,c
+    std::vector<int64_t> default_grid(Pattern pattern);
+    std::vector<int64_t> grid(Pattern pattern);
+
+    // Deterministic for a given --seed, see common/data_generation.h
+    void generate(Pattern pattern, int32_t *index_array, int64_t num_elements, int64_t parameter);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_ACCESS_PATTERNS_H
@@ -0,0 +1,60 @@
+#include "prefetch_distance.h"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+
+#define REPETITIONS_PER_CANDIDATE 3
+#define FINE_STEPS_PER_OCTAVE 8
+
+autotuning::PrefetchDistanceResult autotuning::search_prefetch_distance(
+        const std::function<double(int64_t)> &measure_pass, int64_t max_distance) {
+    std::map<int64_t, double> measured;
+    auto measure = [&](int64_t distance) {
+        if (measured.count(distance)) {
+            return;
+        }
+        double fastest = std::numeric_limits<double>::max();
+        for (int x = 0; x < REPETITIONS_PER_CANDIDATE; x++) {
+            fastest = std::min(fastest, measure_pass(distance));
+        }
+        measured[distance] = fastest;
+    };
+    auto best = [&]() {
+        return std::min_element(measured.begin(), measured.end(), [](const auto &a, const auto &b) {
+            return a.second < b.second;
+        })->first;
+    };
+
+    // Coarse pass over the baseline and powers of two
+    measure(0);
+    for (int64_t distance = 1; distance <= max_distance; distance *= 2) {
+        measure(distance);
+    }
+
+    // Fine pass around the best power of two, nothing to refine if prefetching never helped
+    int64_t coarse_best = best();
+    if (coarse_best > 0) {
+        int64_t low = std::max((int64_t) 1, coarse_best / 2);
+        int64_t high = std::min(max_distance, coarse_best * 2);
+        int64_t step = std::max((int64_t) 1, (high - low) / (2 * FINE_STEPS_PER_OCTAVE));
+        for (int64_t distance = low; distance <= high; distance += step) {
+            measure(distance);
+        }
+    }
+
+    PrefetchDistanceResult result;
+    result.best_distance = best();
+    result.baseline_seconds = measured[0];
+    result.best_seconds = measured[result.best_distance];
+    result.curve.assign(measured.begin(), measured.end());
+    return result;
+}
+
+void autotuning::report(benchmark::State &state, const PrefetchDistanceResult &result) {
+    state.counters["best_distance"] = (double) result.best_distance;
+    state.counters["speedup"] = result.baseline_seconds / result.best_seconds;
+    for (const auto &[distance, seconds] : result.curve) {
+        state.counters["speedup@" + std::to_string(distance)] = result.baseline_seconds / seconds;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_PREFETCH_DISTANCE_H
+#define OPTIMIZATION_TESTING_GROUND_PREFETCH_DISTANCE_H
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/*
+ * Online search for the software prefetch distance of a kernel.
+ * PREFETCH_OFFSET was picked from a paper and one machine, the best value moves with working set size, stride and
+ * core type, so instead we measure it for the kernel and arguments at hand.
+ *
+ * The search is coarse to fine:
+ *   1. Distance 0 (no prefetching) is measured as the baseline.
+ *   2. Powers of two from 1 to max_distance are measured.
+ *   3. The octave either side of the best power of two is walked in FINE_STEPS_PER_OCTAVE steps.
+ * Every candidate is measured REPETITIONS_PER_CANDIDATE times and the fastest run is kept to reject noise.
+ */
+namespace autotuning {
+    struct PrefetchDistanceResult {
+        int64_t best_distance = 0;
+        double baseline_seconds = 0;
+        double best_seconds = 0;
+        // (distance, seconds) for every distance measured, sorted by distance
+        std::vector<std::pair<int64_t, double>> curve;
+    };
+
+    // measure_pass runs one full pass of the kernel at the given distance and returns its duration in seconds
+    PrefetchDistanceResult search_prefetch_distance(const std::function<double(int64_t)> &measure_pass,
+                                                    int64_t max_distance);
+
+    // Adds best_distance, speedup and one speedup@<distance> counter per measured point to the benchmark
+    void report(benchmark::State &state, const PrefetchDistanceResult &result);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_PREFETCH_DISTANCE_H
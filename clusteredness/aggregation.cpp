@@ -0,0 +1,201 @@
+#include "aggregation.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <immintrin.h>
+#include <limits>
+#include <vector>
+#include "../common/data_generation.h"
+
+#define DISPATCH_BLOCK_SIZE (64 * 1024)
+#define DISPATCH_SAMPLE_SIZE 1024
+#define DISPATCH_HYSTERESIS 0.1 // Relative band around the crossover rate in which the previous choice is kept
+#define CALIBRATION_REPETITIONS 5
+
+static uint64_t aggregate_branchy(const uint *array, int64_t num_elements, uint32_t pivot) {
+    uint64_t total = 0;
+    for (int64_t x = 0; x < num_elements; x++) {
+        if (array[x] < pivot) {
+            asm volatile("");
+            total += 1;
+        } else {
+            asm volatile("");
+            total += 2;
+        }
+    }
+    return total;
+}
+
+static uint64_t aggregate_cmov(const uint *array, int64_t num_elements, uint32_t pivot) {
+    uint64_t total = 0;
+    for (int64_t x = 0; x < num_elements; x++) {
+        uint64_t increment = 1;
+        uint64_t two = 2;
+        asm("cmpl %[pivot], %[value]\n\t"
+            "cmovae %[two], %[increment]"
+            : [increment] "+r"(increment)
+            : [value] "r"(array[x]), [pivot] "r"(pivot), [two] "r"(two)
+            : "cc");
+        total += increment;
+    }
+    return total;
+}
+
+// Every lane adds 2 + (value < pivot ? -1 : 0), the 32 bit lanes cannot overflow below 2^34 elements
+__attribute__((target("avx2")))
+static uint64_t aggregate_avx2(const uint *array, int64_t num_elements, uint32_t pivot) {
+    const __m256i pivots = _mm256_set1_epi32((int) pivot);
+    const __m256i twos = _mm256_set1_epi32(2);
+    const __m256i sign = _mm256_set1_epi32((int) 0x80000000);
+    __m256i totals = _mm256_setzero_si256();
+    int64_t x = 0;
+    for (; x + 8 <= num_elements; x += 8) {
+        __m256i values = _mm256_loadu_si256((const __m256i *) &array[x]);
+        // AVX2 only has a signed compare, flipping the sign bit of both sides makes it unsigned
+        __m256i less = _mm256_cmpgt_epi32(_mm256_xor_si256(pivots, sign), _mm256_xor_si256(values, sign));
+        totals = _mm256_add_epi32(totals, _mm256_add_epi32(twos, less));
+    }
+    alignas(32) uint32_t lanes[8];
+    _mm256_store_si256((__m256i *) lanes, totals);
+    uint64_t total = 0;
+    for (auto lane : lanes) {
+        total += lane;
+    }
+    for (; x < num_elements; x++) {
+        total += array[x] < pivot ? 1 : 2;
+    }
+    return total;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t aggregate_avx512(const uint *array, int64_t num_elements, uint32_t pivot) {
+    const __m512i pivots = _mm512_set1_epi32((int) pivot);
+    const __m512i ones = _mm512_set1_epi32(1);
+    const __m512i twos = _mm512_set1_epi32(2);
+    __m512i totals = _mm512_setzero_si512();
+    int64_t x = 0;
+    for (; x + 16 <= num_elements; x += 16) {
+        __m512i values = _mm512_loadu_si512((const void *) &array[x]);
+        __mmask16 less = _mm512_cmplt_epu32_mask(values, pivots);
+        totals = _mm512_add_epi32(totals, _mm512_mask_blend_epi32(less, twos, ones));
+    }
+    alignas(64) uint32_t lanes[16];
+    _mm512_store_si512((void *) lanes, totals);
+    uint64_t total = 0;
+    for (auto lane : lanes) {
+        total += lane;
+    }
+    for (; x < num_elements; x++) {
+        total += array[x] < pivot ? 1 : 2;
+    }
+    return total;
+}
+
+bool aggregation::supported(KernelShape shape) {
+    switch (shape) {
+        case KernelShape::Avx2:
+            return __builtin_cpu_supports("avx2");
+        case KernelShape::Avx512:
+            return __builtin_cpu_supports("avx512f");
+        default:
+            return true;
+    }
+}
+
+const char *aggregation::name(KernelShape shape) {
+    switch (shape) {
+        case KernelShape::Compiler:
+            return "compiler";
+        case KernelShape::Branchy:
+            return "branchy";
+        case KernelShape::Cmov:
+            return "cmov";
+        case KernelShape::Avx2:
+            return "avx2";
+        case KernelShape::Avx512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+uint64_t aggregation::aggregate(KernelShape shape, const uint *array, int64_t num_elements, uint32_t pivot) {
+    switch (shape) {
+        case KernelShape::Avx2:
+            return aggregate_avx2(array, num_elements, pivot);
+        case KernelShape::Avx512:
+            return aggregate_avx512(array, num_elements, pivot);
+        case KernelShape::Cmov:
+            return aggregate_cmov(array, num_elements, pivot);
+        default:
+            return aggregate_branchy(array, num_elements, pivot);
+    }
+}
+
+static double fastest_seconds(aggregation::KernelShape shape, const std::vector<uint> &block, uint32_t pivot) {
+    double fastest = std::numeric_limits<double>::max();
+    for (int repetition = 0; repetition < CALIBRATION_REPETITIONS; repetition++) {
+        auto start = std::chrono::steady_clock::now();
+        volatile uint64_t total = aggregation::aggregate(shape, block.data(), (int64_t) block.size(), pivot);
+        (void) total;
+        fastest = std::min(fastest, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return fastest;
+}
+
+aggregation::AdaptiveAggregator::AdaptiveAggregator(KernelShape branchless) : branchless(branchless) {
+    const uint32_t pivot = RAND_MAX / 2;
+    std::vector<uint> clustered(DISPATCH_BLOCK_SIZE, 0);
+    std::vector<uint> random_outcomes(DISPATCH_BLOCK_SIZE);
+    data_generation::fill_uniform(random_outcomes.data(), DISPATCH_BLOCK_SIZE,
+                                  data_generation::Random(data_generation::Stream::Calibration));
+
+    // Branchy cost grows linearly with the transition rate, random outcomes change half of the time
+    double branchy_clustered = fastest_seconds(KernelShape::Branchy, clustered, pivot);
+    double branchy_random = fastest_seconds(KernelShape::Branchy, random_outcomes, pivot);
+    double branchless_cost = fastest_seconds(branchless, random_outcomes, pivot);
+    double slope = (branchy_random - branchy_clustered) / 0.5;
+    crossover = slope > 0 ? std::clamp((branchless_cost - branchy_clustered) / slope, 0.0, 1.0) : 0.0;
+}
+
+uint64_t aggregation::AdaptiveAggregator::aggregate(const uint *array, int64_t num_elements, uint32_t pivot) {
+    uint64_t total = 0;
+    for (int64_t begin = 0; begin < num_elements; begin += DISPATCH_BLOCK_SIZE) {
+        int64_t length = std::min((int64_t) DISPATCH_BLOCK_SIZE, num_elements - begin);
+        int64_t sample = std::min((int64_t) DISPATCH_SAMPLE_SIZE, length);
+
+        // Run length statistics of the sampled prefix, counted without branching on the data and without a carried
+        // dependency between elements so that the compiler can vectorise it
+        int64_t taken = array[begin] < pivot;
+        int64_t transitions = 0;
+        for (int64_t x = begin + 1; x < begin + sample; x++) {
+            taken += array[x] < pivot;
+            transitions += (array[x] < pivot) != (array[x - 1] < pivot);
+        }
+        double transition_rate = sample > 1 ? (double) transitions / (double) (sample - 1) : 0.0;
+
+        if (branchy && transition_rate > crossover * (1 + DISPATCH_HYSTERESIS)) {
+            branchy = false;
+        } else if (!branchy && transition_rate < crossover * (1 - DISPATCH_HYSTERESIS)) {
+            branchy = true;
+        }
+
+        total += aggregation::aggregate(branchy ? KernelShape::Branchy : branchless, &array[begin], length, pivot);
+        blocks++;
+        branchy_blocks += branchy;
+        selectivity_sum += (double) taken / (double) sample;
+        clusteredness_sum += 1 - transition_rate;
+    }
+    return total;
+}
+
+double aggregation::AdaptiveAggregator::branchy_block_fraction() const {
+    return blocks ? (double) branchy_blocks / (double) blocks : 0;
+}
+
+double aggregation::AdaptiveAggregator::mean_estimated_selectivity() const {
+    return blocks ? selectivity_sum / (double) blocks : 0;
+}
+
+double aggregation::AdaptiveAggregator::mean_estimated_clusteredness() const {
+    return blocks ? clusteredness_sum / (double) blocks : 0;
+}
@@ -0,0 +1,72 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_AGGREGATION_H
+#define OPTIMIZATION_TESTING_GROUND_AGGREGATION_H
+
+#include <cstdint>
+#include <sys/types.h>
+
+/*
+ * The selectivity filter aggregation from clusteredness.cpp, total += array[x] < pivot ? 1 : 2, in several code shapes.
+ *   Compiler: leaves the choice to the compiler (only used inline by BM_Clusteredness)
+ *   Branchy:  a conditional branch per element, an empty asm statement in each arm stops the compiler if-converting it
+ *   Cmov:     a cmov per element, written in inline asm so it cannot be turned back into a branch
+ *   Avx2:     8 elements per compare, the compare mask selects the increment, no branch on the data at all
+ *   Avx512:   16 elements per compare with a mask register, as above
+ */
+namespace aggregation {
+    enum class KernelShape {
+        Compiler,
+        Branchy,
+        Cmov,
+        Avx2,
+        Avx512,
+    };
+
+    // Whether the CPU we are running on can execute the shape
+    bool supported(KernelShape shape);
+    const char *name(KernelShape shape);
+
+    uint64_t aggregate(KernelShape shape, const uint *array, int64_t num_elements, uint32_t pivot);
+
+    /*
+     * Picks the branchy or a branchless shape per block of the input.
+     *
+     * The research in clusteredness.cpp shows a branch beats cmov once its outcomes are clustered, as the predictor
+     * only misses where a run of equal outcomes ends. So the first DISPATCH_SAMPLE_SIZE elements of every
+     * DISPATCH_BLOCK_SIZE block are sampled for their run length statistics:
+     *   selectivity   = fraction of sampled outcomes that are true
+     *   transition rate = fraction of neighbouring outcomes that differ (1 - clusteredness), the branchy shape's
+     *                     expected miss rate
+     * The block is run branchy when the transition rate is below the crossover rate, with a small hysteresis band
+     * around it so that data hovering at the crossover does not flip the choice on every block.
+     *
+     * The crossover rate is calibrated once on construction: the branchy shape is timed on a block without any
+     * transitions and on one with random outcomes, the branchless shape on either, and the rate at which the two cost
+     * lines cross is used.
+     */
+    class AdaptiveAggregator {
+    public:
+        explicit AdaptiveAggregator(KernelShape branchless);
+
+        uint64_t aggregate(const uint *array, int64_t num_elements, uint32_t pivot);
+
+        double crossover_transition_rate() const {
+            return crossover;
+        }
+
+        // Statistics over everything aggregated so far
+        double branchy_block_fraction() const;
+        double mean_estimated_selectivity() const;
+        double mean_estimated_clusteredness() const;
+
+    private:
+        KernelShape branchless;
+        double crossover = 0;
+        bool branchy = false;
+        int64_t blocks = 0;
+        int64_t branchy_blocks = 0;
+        double selectivity_sum = 0;
+        double clusteredness_sum = 0;
+    };
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_AGGREGATION_H
@@ -3,8 +3,12 @@
 //
 
 #include "clusteredness.h"
+#include <algorithm>
 #include <cmath>
-#include "ittnotify.h"
+#include <string>
+#include "aggregation.h"
+#include "../common/data_generation.h"
+#include "../instrumentation/perf_counters.h"
 
 /*
  * Arguments.
@@ -38,37 +42,106 @@
  * Therefore, removing if conversion when a branch has high clusteredness appears to be a valuable optimization.
 */
 #define NUM_ITERATIONS 10000000
+#define TREND_SEGMENT_LENGTH (1024 * 1024) // Elements between shifts in clusteredness for the shifting data family
+
+using aggregation::KernelShape;
+
+/*
+ * Fills array with values that repeat the preceding value with clusteredness probability.
+ * When is_shifting, the trend changes every TREND_SEGMENT_LENGTH elements: even segments use clusteredness and odd
+ * segments are fully random, so a dispatcher that only looked at the data once would be wrong half of the time.
+ */
+static uint *generate_data(double clusteredness, bool is_shifting) {
+    auto* array = (uint*) malloc(sizeof(u_int32_t) * NUM_ITERATIONS);
+    if (!is_shifting) {
+        data_generation::fill_clustered(array, NUM_ITERATIONS,
+                                        data_generation::Random(data_generation::Stream::Clustering), clusteredness);
+        return array;
+    }
+    for (int64_t begin = 0; begin < NUM_ITERATIONS; begin += TREND_SEGMENT_LENGTH) {
+        int64_t segment = begin / TREND_SEGMENT_LENGTH;
+        int64_t length = std::min((int64_t) TREND_SEGMENT_LENGTH, NUM_ITERATIONS - begin);
+        data_generation::fill_clustered(&array[begin], length,
+                                        data_generation::Random(data_generation::Stream::Clustering, segment),
+                                        segment % 2 == 0 ? clusteredness : 0.0);
+    }
+    return array;
+}
+
+template<KernelShape shape, bool is_shifting = false>
 static void BM_Clusteredness(benchmark::State& state) {
+    if (!aggregation::supported(shape)) {
+        state.SkipWithError((std::string(aggregation::name(shape)) + " is not supported on this CPU").c_str());
+        return;
+    }
+
     // Setup
     double selectivity = ((float) state.range(0)) / 100.0;
     double clusteredness = ((float)state.range(1)) / 100.0;
 
     long selectivity_pivot_position = RAND_MAX * selectivity;
-    long clusteredness_pivot_position = RAND_MAX * clusteredness;
+    auto* array = generate_data(clusteredness, is_shifting);
 
-    auto* array = (uint*) malloc(sizeof(u_int32_t) * NUM_ITERATIONS);
-    srand(time(NULL));
-    int prev = random();
-    for (int x = 0; x < NUM_ITERATIONS; x ++) {
-        if (random() < clusteredness_pivot_position) {
-            array[x] = prev;
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        if constexpr (shape == KernelShape::Compiler) {
+            volatile __uint32_t total = 0;
+            for (__uint32_t x = 0; x < NUM_ITERATIONS; x ++) {
+                if (array[x] < selectivity_pivot_position) {
+                    total += 1;
+                } else {
+                    total += 2;
+                }
+            }
         } else {
-            array[x] = random();
+            benchmark::DoNotOptimize(aggregation::aggregate(shape, array, NUM_ITERATIONS, selectivity_pivot_position));
         }
-        prev = array[x];
+        counters.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+
+    // Teardown
+    free(array);
+}
+
+/*
+ * The selectivity filter aggregation through aggregation::AdaptiveAggregator, which picks the branchy shape or the
+ * given branchless shape per block from a sample of the block.
+ * Run over the same grid as BM_Clusteredness it should track the faster of BM_Clusteredness<Branchy> and
+ * BM_Clusteredness<branchless> everywhere, the gap to that is the overhead of sampling and of a wrong pick.
+ * On the shifting data family neither static shape is right for the whole input, there it should beat both.
+ */
+template<KernelShape branchless, bool is_shifting = false>
+static void BM_Clusteredness_Adaptive(benchmark::State& state) {
+    if (!aggregation::supported(branchless)) {
+        state.SkipWithError((std::string(aggregation::name(branchless)) + " is not supported on this CPU").c_str());
+        return;
     }
 
+    // Setup
+    double selectivity = ((float) state.range(0)) / 100.0;
+    double clusteredness = ((float)state.range(1)) / 100.0;
+
+    long selectivity_pivot_position = RAND_MAX * selectivity;
+    auto* array = generate_data(clusteredness, is_shifting);
+    aggregation::AdaptiveAggregator aggregator(branchless);
+
     // Actual benchmark
+    perf_counters::PerfCounters counters;
     for (auto _ : state) {
-        volatile __uint32_t total = 0;
-        for (__uint32_t x = 0; x < NUM_ITERATIONS; x ++) {
-            if (array[x] < selectivity_pivot_position) {
-                total += 1;
-            } else {
-                total += 2;
-            }
-        }
+        counters.start();
+        benchmark::DoNotOptimize(aggregator.aggregate(array, NUM_ITERATIONS, selectivity_pivot_position));
+        counters.stop();
     }
+    counters.report(state);
+    data_generation::report(state);
+    state.counters["branchy_blocks"] = aggregator.branchy_block_fraction();
+    state.counters["estimated_selectivity"] = aggregator.mean_estimated_selectivity();
+    state.counters["estimated_clusteredness"] = aggregator.mean_estimated_clusteredness();
+    state.counters["crossover_clusteredness"] = 1 - aggregator.crossover_transition_rate();
 
     // Teardown
     free(array);
@@ -87,38 +160,70 @@ int expensive_function2() {
 #define CLUSTEREDNESS 0.0
 static void BM_Clusteredness_New(benchmark::State& state) {
     int* yesNoArr = (int*) malloc(sizeof(int) * NUM_ITERATIONS);
-    for (volatile int x = 0; x < NUM_ITERATIONS; x ++) {
-        if (((float) x) < ((float) NUM_ITERATIONS) * CLUSTEREDNESS) {
-            yesNoArr[x] = 0;
-        } else {
-            yesNoArr[x] = rand() % 2;
+    const data_generation::Random random(data_generation::Stream::Values);
+    data_generation::parallel_for(NUM_ITERATIONS, [&](int64_t begin, int64_t end) {
+        for (int64_t x = begin; x < end; x ++) {
+            if (((float) x) < ((float) NUM_ITERATIONS) * CLUSTEREDNESS) {
+                yesNoArr[x] = 0;
+            } else {
+                yesNoArr[x] = random.bits(x) & 1;
+            }
         }
-    }
-
-    __itt_domain *domain = __itt_domain_create("Hardware Prefetcher");
-    __itt_string_handle *task = __itt_string_handle_create("Memory Load Iteration");
-    __itt_task_begin(domain, __itt_null, __itt_null, task);
+    });
 
     // Actual benchmark
     double a = 100;
+    perf_counters::PerfCounters counters;
     for (auto _ : state) {
+        counters.start();
         for (volatile uint32_t x = 0; x < NUM_ITERATIONS; x ++) {
             double b = (float) x;
             a /= x < NUM_ITERATIONS / 2 ? b * 147.2: b / 423.1 ;
         }
+        counters.stop();
     }
     benchmark::DoNotOptimize(a);
-
-    __itt_task_end(domain);
+    counters.report(state);
+    data_generation::report(state);
 
 }
 
 
 // Provides arguments of the cross product of [0..101, 10] x [0..101, 10]
 static void CustomArguments(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"selectivity", "clusteredness"});
+    for (int selectivity = 0; selectivity <= 100; selectivity += 10) {
+        for (int clusteredness = 0; clusteredness <= 100; clusteredness += 10) {
+            b->Args({selectivity, clusteredness});
+        }
+    }
+}
+
+// Clustered segments alternate with random ones, selectivity is kept at the most volatile 50%
+static void ShiftingArguments(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"selectivity", "clusteredness"});
+    for (int clusteredness : {90, 99}) {
+        b->Args({50, clusteredness});
+    }
 }
 
 
 void clusteredness::register_benchmarks() {
     BENCHMARK(BM_Clusteredness_New)->Iterations(10);
+
+    // Crossover map of the code shapes over the full selectivity x clusteredness grid
+    BENCHMARK_TEMPLATE(BM_Clusteredness, KernelShape::Compiler)->Apply(CustomArguments)->Iterations(10);
+    BENCHMARK_TEMPLATE(BM_Clusteredness, KernelShape::Branchy)->Apply(CustomArguments)->Iterations(10);
+    BENCHMARK_TEMPLATE(BM_Clusteredness, KernelShape::Cmov)->Apply(CustomArguments)->Iterations(10);
+    BENCHMARK_TEMPLATE(BM_Clusteredness, KernelShape::Avx2)->Apply(CustomArguments)->Iterations(10);
+    BENCHMARK_TEMPLATE(BM_Clusteredness, KernelShape::Avx512)->Apply(CustomArguments)->Iterations(10);
+
+    // The adaptive dispatcher against the same grid, once per branchless shape it can fall back to
+    BENCHMARK_TEMPLATE(BM_Clusteredness_Adaptive, KernelShape::Cmov)->Apply(CustomArguments)->Iterations(10);
+    BENCHMARK_TEMPLATE(BM_Clusteredness_Adaptive, KernelShape::Avx2)->Apply(CustomArguments)->Iterations(10);
+
+    // Data whose trend shifts part way through, the dispatcher has to re-evaluate to keep up
+    BENCHMARK_TEMPLATE(BM_Clusteredness, KernelShape::Branchy, true)->Apply(ShiftingArguments)->Iterations(10);
+    BENCHMARK_TEMPLATE(BM_Clusteredness, KernelShape::Cmov, true)->Apply(ShiftingArguments)->Iterations(10);
+    BENCHMARK_TEMPLATE(BM_Clusteredness_Adaptive, KernelShape::Cmov, true)->Apply(ShiftingArguments)->Iterations(10);
 }
\ No newline at end of file
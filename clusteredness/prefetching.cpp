@@ -1,44 +1,40 @@
 #include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
 #include <random>
 #include "prefetching.h"
-#include <boost/multiprecision/cpp_int.hpp>
-#include "ittnotify.h"
-
-using namespace boost::multiprecision;
+#include "../access_patterns/access_patterns.h"
+#include "../common/cache.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/records.h"
+#include "../common/options.h"
+#include "../autotuning/prefetch_distance.h"
+#include "../compression/index_stream.h"
+#include "../memory/allocators.h"
+#include "../memory/out_of_core.h"
+#include "../instrumentation/perf_counters.h"
+#include "../simd/gather.h"
 
 
 // Tunable parameters
 #define PREFETCH_OFFSET 64 // Assuming 64 for now, taken from https://www.cl.cam.ac.uk/~sa614/papers/Software-Prefetching-CGO2017.pdf
 // After testing this seemed about right, lead to large speedups
-#define CACHE_SIZE 32 * 1024 // Assume the L1 data cache is 32KB, this is the case on my machine and the lab machine I was testing on
+#define AUTOTUNE_MAX_PREFETCH_DISTANCE 1024 // --autotune_max_distance, upper bound of the online distance search
 #define MAX_NUM_ELEMENTS_IN_ARRAY 100000001
-#define CACHE_LINE_SIZE_IN_BITS 64 * 8
-#define NUM_32BIT_INTS_IN_CACHE_LINE CACHE_LINE_SIZE_IN_BITS / 32
-
-// Test Control
-#define TESTING_EFFECTS_OF_CACHE_FLUSHING false
-#define REPETITIONS_OF_EXPERIMENTS 100
-#define ADD_VTUNE_INSTRUMENTATION false
-#define SHOULD_PREFETCH_INDEX_ARRAY false
-#define TESTING_SORTEDNESS false
-#define SORTEDNESS_CLUSTERED false
-#define RANDOM_INDEX_ARRAY_ADDITION false
-#define RANDOM_INDEX_ARRAY_ADDITION_RANGE_IN_ELEMENTS_MAX NUM_32BIT_INTS_IN_CACHE_LINE * 1024 * 1024 * 16 // 256 is where it appears to be even with the prefetching
-#define RANDOM_STRIDE_FROM_PREVIOUS false
-#define RANDOM_STRIDE_FROM_PREVIOUS_RANGE NUM_32BIT_INTS_IN_CACHE_LINE * 1024 * 1024 * 16
-#define RANDOM_STRIDE_DISTANCE 16348 * 2 * 2 * 2 * 2 * 2 * 2
+#define NUM_ELEMENTS_IN_EXPERIMENTS 100000000
+
+// Test Control, defaults for the runtime options of the same (lower case) name
+// The access pattern under test is chosen at runtime, see access_patterns/access_patterns.h
+#define TESTING_EFFECTS_OF_CACHE_FLUSHING false // --prefetching_flush_cache, adds the cold state to --prefetching_cache_states
+#define REPETITIONS_OF_EXPERIMENTS 100 // --prefetching_iterations
+#define SHOULD_PREFETCH_INDEX_ARRAY false // --prefetch_index_array
+#define AUTOTUNE_PREFETCH_DISTANCE false // --prefetching_autotune
+#define TESTING_COMPRESSED_INDEXES true // --prefetching_compressed, adds BM_Prefetching_Compressed to every pattern
 #define CONSTANT_LARGE_STRIDE_DISTANCE_MAX 1024 * 2 + 3
 
 
-static void *flush_data_cache() {
-    const int size = 40 * 1024 * 1024; // Allocate 40M. Much larger than L3 cache
-    char *c = (char *) malloc(size);
-    for (volatile int j = 0; j < size; j++) {
-        benchmark::DoNotOptimize(c[j] = 0);
-    }
-    return c;
-}
-
 /*
  * This benchmark aims to show the speedup provided by hardware prefetching on a per element read basis
  * Higher amounts of memory should have an overall higher throughput of the read due to the predictable stride
@@ -50,28 +46,40 @@ static void *flush_data_cache() {
 template<bool is_cache_flushed, bool is_software_prefetching_used>
 static void BM_HardwarePrefetching(benchmark::State &state) {
     // Setup
-    srand(time(NULL));
     auto num_elements = state.range(0);
-    auto *array = (uint512_t *) malloc(sizeof(uint512_t) * num_elements);
-    for (uint32_t x = 0; x < num_elements; x++) {
-        array[x] = rand();
-    }
+    using Line = records::Record<RECORD_LINE_SIZE>;
+    auto *array = (Line *) aligned_alloc(RECORD_LINE_SIZE, sizeof(Line) * num_elements);
+    const data_generation::Random random(data_generation::Stream::Values);
+    data_generation::parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+        for (int64_t x = begin; x < end; x++) {
+            array[x] = {};
+            array[x].fields[0] = (int32_t) random.value(x);
+        }
+    });
+
+    const cache::Precondition precondition(is_cache_flushed ? cache::State::Cold : cache::State::Unmanaged,
+                                           {{array, sizeof(Line) * num_elements}});
 
     // Actual benchmark
+    perf_counters::PerfCounters counters;
     for (auto _ : state) {
         if constexpr (is_cache_flushed) {
             state.PauseTiming();
-            free(flush_data_cache());
+            precondition.apply();
             state.ResumeTiming();
         }
+        counters.start();
         for (int x = 0; x < num_elements; x++) {
             if constexpr (is_software_prefetching_used) {
                 // Taken from https://www.cl.cam.ac.uk/~sa614/papers/Software-Prefetching-CGO2017.pdf
                 __builtin_prefetch(&array[x + 2 * PREFETCH_OFFSET]);
             }
-            benchmark::DoNotOptimize(array[x]++);
+            benchmark::DoNotOptimize(array[x].fields[0]++);
         }
+        counters.stop();
     }
+    counters.report(state);
+    data_generation::report(state);
 
     // Teardown
     free(array);
@@ -92,98 +100,47 @@ static void BM_HardwarePrefetching(benchmark::State &state) {
  *      Yes potentially though the idea is that the index array is iterated through sequentially and therefore the
  *      prefetcher should notice this stride and prefetch the index array into cache whilst leaving the rest of the cache
  *      open for use
- *    Why are you using a 512 bit integer?
- *      So that each element in our array spans one cache line, this means that the performance between sequential access
- *      and random access are more comparable as each access is one cache line, with another structure Hardware gets to access
- *      cacheline / sizeof(element_structure) sequentially.
+ *    Why int32_t elements?
+ *      Sequential access then gets cacheline / sizeof(int32_t) elements out of every line it loads, random access one.
+ *      The record_layouts suite repeats this kernel over records of 4 to 256 bytes, where each access is a line or more.
  */
 
-template<bool shuffled_memory_access, bool is_cache_flushed, bool is_software_prefetching_used>
-static void BM_Prefetching(benchmark::State &state) {
+template<bool is_software_prefetching_used>
+static void BM_Prefetching(benchmark::State &state, access_patterns::Pattern pattern, cache::State cache_state,
+                           allocators::Allocator allocator) {
     // Setup
-    srand(time(NULL));
     auto num_elements = state.range(0);
 //    std::cout << "Num elements: " << num_elements << std::endl;
-    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
-    for (volatile int32_t x = 0; x < num_elements; x += 1) {
-        array[x] = rand();
-    }
+    auto array_allocation = allocators::allocate(allocator, sizeof(int32_t) * num_elements);
+    auto *array = (int32_t *) array_allocation.memory;
+    datasets::values(num_elements)->copy_to(array);
 
-    __itt_domain *domain = __itt_domain_create("Hardware Prefetcher");
-    __itt_string_handle *task = __itt_string_handle_create("Memory Load Iteration");
+    const bool should_prefetch_index_array = options::get_bool("prefetch_index_array", SHOULD_PREFETCH_INDEX_ARRAY);
 
-    // Create an index array then randomly shuffle it
+    // Create an index array following the requested access pattern
+    // The look-ahead prefetches read up to 2 * PREFETCH_OFFSET elements past the end so the tail is padded with zeros
     int32_t INDEX_ARRAY_SIZE = num_elements;
-    auto *index_array = (int32_t *) malloc(sizeof(int32_t) * INDEX_ARRAY_SIZE);
-    for (volatile int32_t x = 0; x < INDEX_ARRAY_SIZE; x++) {
-        index_array[x] = x;
-    }
-
-    // Mess with the sortedness
-    if constexpr(TESTING_SORTEDNESS) {
-        int unsortedness = 100 - state.range(1);
-        if constexpr(SORTEDNESS_CLUSTERED) {
-            for (volatile int x = 0; x < INDEX_ARRAY_SIZE; x++) {
-                if (x % 100 < unsortedness) {
-                    index_array[x] = rand() % INDEX_ARRAY_SIZE;
-                }
-            }
-        } else {
-            for (volatile int x = 0; x < INDEX_ARRAY_SIZE; x++) {
-                if (rand() % 100 < unsortedness) {
-                    index_array[x] = rand() % INDEX_ARRAY_SIZE;
-                }
-            }
-        }
-    }
-
-    if constexpr(RANDOM_INDEX_ARRAY_ADDITION) {
-        int offset = state.range(1) + 1;
-        for (volatile int x = 0; x < INDEX_ARRAY_SIZE; x++) {
-            // The following code will add +- RANDOM_INDEX_ARRAY_ADDITION_RANGE_IN_ELEMENTS to x while keeping it in bounds
-            int amount_to_add =
-                    (rand() % (offset))
-                    - (rand() % offset);
-            int index = x + amount_to_add;
-            int in_bounds = std::min(INDEX_ARRAY_SIZE, std::max(0, index));
-            index_array[x] = in_bounds;
-        }
-    }
-
-    if constexpr(RANDOM_STRIDE_FROM_PREVIOUS) {
-        // Deal with the first array element, set it to 0 because one element will not have an effect on the
-        // run time of the huge array
-        index_array[0] = 0;
-
-        int offset = state.range(1) + 1;
-        for (volatile int x = 1; x < INDEX_ARRAY_SIZE; x++) {
-            // The following code will add +- RANDOM_INDEX_ARRAY_ADDITION_RANGE_IN_ELEMENTS to x while keeping it in bounds
-            int amount_to_add =
-                    (rand() % offset)
-                    - (rand() % offset);
-//            std::cout << "Amount to add: " << amount_to_add << std::endl;
-            int index = index_array[x - 1] + amount_to_add;
-            int in_bounds = std::min(INDEX_ARRAY_SIZE, std::max(0, index));
-
-//            std::cout << in_bounds << std::endl;
-            index_array[x] = in_bounds;
-        }
-    }
-
-
-    if constexpr (shuffled_memory_access) {
-        std::shuffle(&index_array[0], &index_array[INDEX_ARRAY_SIZE], std::mt19937(std::random_device()()));
-    }
+    auto index_array_allocation = allocators::allocate(allocator,
+                                                       sizeof(int32_t) * (INDEX_ARRAY_SIZE + 2 * PREFETCH_OFFSET));
+    auto *index_array = (int32_t *) index_array_allocation.memory;
+    memset(&index_array[INDEX_ARRAY_SIZE], 0, sizeof(int32_t) * 2 * PREFETCH_OFFSET);
+    datasets::indexes(pattern, INDEX_ARRAY_SIZE, access_patterns::has_parameter(pattern) ? state.range(1) : 0)
+            ->copy_to(index_array);
+    const cache::Precondition precondition(cache_state, {{array, sizeof(int32_t) * num_elements},
+                                                         {index_array, index_array_allocation.bytes}});
 
     // Actual benchmark
+    perf_counters::PerfCounters counters;
+    out_of_core::FaultCounters faults;
     for (auto _ : state) {
-        if constexpr (is_cache_flushed) {
+        if (cache_state != cache::State::Unmanaged) {
             state.PauseTiming();
-            free(flush_data_cache());
+            precondition.apply();
             // Load in the first part of the index array in after we flush cache (as much as we can fit into cache
             // to give the hardware pre-fetched a fighting chance of working without the initial delay
-            if constexpr(SHOULD_PREFETCH_INDEX_ARRAY) {
-                for (volatile int x = 0; x < std::min((ulong) INDEX_ARRAY_SIZE, CACHE_SIZE / sizeof(uint32_t)); x++) {
+            if (cache_state == cache::State::Cold && should_prefetch_index_array) {
+                const auto l1d_elements = cache::topology().l1d_bytes / sizeof(uint32_t);
+                for (int64_t x = 0; x < std::min((int64_t) INDEX_ARRAY_SIZE, (int64_t) l1d_elements); x++) {
                     __builtin_prefetch(&index_array[x]);
                 }
                 // Sleep for 0.005 seconds to allow the load in from memory
@@ -192,9 +149,8 @@ static void BM_Prefetching(benchmark::State &state) {
             state.ResumeTiming();
         }
 
-        if constexpr(ADD_VTUNE_INSTRUMENTATION) {
-            __itt_task_begin(domain, __itt_null, __itt_null, task);
-        }
+        faults.start();
+        counters.start();
         for (int x = 0; x < num_elements; x++) {
             if constexpr (is_software_prefetching_used) {
                 // Taken from https://www.cl.cam.ac.uk/~sa614/papers/Software-Prefetching-CGO2017.pdf
@@ -203,46 +159,53 @@ static void BM_Prefetching(benchmark::State &state) {
             }
             benchmark::DoNotOptimize(array[index_array[x]]++);
         }
-        if constexpr(ADD_VTUNE_INSTRUMENTATION) {
-            __itt_task_end(domain);
-        }
+        counters.stop();
+        faults.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    allocators::report(state, array_allocation);
+    if (array_allocation.fd != -1) {
+        // Over a file (--allocators=file) a miss can be a page fault, the out_of_core suite varies how pages are read
+        faults.report(state);
+        state.SetItemsProcessed(num_elements * state.iterations());
     }
 
     // Teardown
-    free(index_array);
-    free(array);
+    allocators::release(index_array_allocation);
+    allocators::release(array_allocation);
 }
 
 template<bool is_software_prefetching_used>
-static void BM_Large_Stride_Distance(benchmark::State &state) {
+static void BM_Large_Stride_Distance(benchmark::State &state, allocators::Allocator allocator) {
     // Setup
-    srand(time(NULL));
     const auto num_elements_orig = state.range(0);
     const auto stride_distance = state.range(1);
 
     // Make sure that we access the same number of elements in each run
     auto num_elements = num_elements_orig * stride_distance;
-    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    auto array_allocation = allocators::allocate(allocator, sizeof(int32_t) * num_elements);
+    auto *array = (int32_t *) array_allocation.memory;
     if (!array) {
         std::cout << "Could not alloc" << std::endl;
     }
-    for (volatile uint64_t x = 0; x < num_elements; x += 1) {
-        array[x] = rand();
-    }
+    datasets::values(num_elements)->copy_to(array);
 
-
-    __itt_domain *domain = __itt_domain_create("Hardware Prefetcher");
-    __itt_string_handle *task = __itt_string_handle_create("Memory Load Iteration");
+    // Only the elements the kernel visits need flushing, which keeps the largest strides cheap to set up
+    const cache::Precondition precondition(cache::State::Cold,
+                                           {{array, sizeof(int32_t) * num_elements,
+                                             sizeof(int32_t) * (size_t) stride_distance}});
 
     // Actual benchmark
+    perf_counters::PerfCounters counters;
+    out_of_core::FaultCounters faults;
     for (auto _ : state) {
-            state.PauseTiming();
-            free(flush_data_cache());
-            state.ResumeTiming();
+        state.PauseTiming();
+        precondition.apply();
+        state.ResumeTiming();
 
-        if constexpr(ADD_VTUNE_INSTRUMENTATION) {
-            __itt_task_begin(domain, __itt_null, __itt_null, task);
-        }
+        faults.start();
+        counters.start();
         for (volatile uint64_t x = 0; x < num_elements; x += stride_distance) {
             if constexpr (is_software_prefetching_used) {
                 // Taken from https://www.cl.cam.ac.uk/~sa614/papers/Software-Prefetching-CGO2017.pdf
@@ -250,54 +213,252 @@ static void BM_Large_Stride_Distance(benchmark::State &state) {
             }
             benchmark::DoNotOptimize(array[x]++);
         }
-        if constexpr(ADD_VTUNE_INSTRUMENTATION) {
-            __itt_task_end(domain);
+        counters.stop();
+        faults.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    allocators::report(state, array_allocation);
+    if (array_allocation.fd != -1) {
+        faults.report(state);
+        state.SetItemsProcessed(num_elements_orig * state.iterations());
+    }
+
+    // Teardown
+    allocators::release(array_allocation);
+}
+
+/*
+ * BM_Prefetching with the indirect update vectorised through hardware gathers (and scatters on AVX-512), see
+ * simd/gather.h. The ISA is requested per benchmark and checked against cpuid at runtime, a CPU without it runs the
+ * best ISA below it and says so in the benchmark's label.
+ * conflict_vectors is the fraction of vectors that held duplicate indexes and were updated by the scalar loop.
+ */
+static_assert(2 * PREFETCH_OFFSET <= DATASET_PADDING, "The look-ahead reads past the end of the indexes");
+
+template<bool is_software_prefetching_used>
+static void BM_Prefetching_Simd(benchmark::State &state, access_patterns::Pattern pattern,
+                                simd_gather::Isa requested) {
+    simd_gather::Isa isa;
+    auto kernel = simd_gather::select(requested, &isa);
+
+    // Setup
+    auto num_elements = state.range(0);
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    datasets::values(num_elements)->copy_to(array);
+    // The indexes are only read, the shared dataset's padding holds the look-ahead of 2 * PREFETCH_OFFSET elements
+    const auto indexes = datasets::indexes(pattern, num_elements,
+                                           access_patterns::has_parameter(pattern) ? state.range(1) : 0);
+    const int32_t *index_array = indexes->data();
+
+    // Actual benchmark
+    int64_t conflicts = 0;
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        conflicts += kernel(array, index_array, num_elements, is_software_prefetching_used ? PREFETCH_OFFSET : 0);
+        counters.stop();
+    }
+    benchmark::DoNotOptimize(array[0]);
+    counters.report(state);
+    data_generation::report(state);
+    state.SetLabel(simd_gather::name(isa));
+    const int64_t lanes = isa == simd_gather::Isa::Avx512 ? 16 : 8;
+    state.counters["conflict_vectors"] = isa == simd_gather::Isa::Scalar
+                                         ? 0 : (double) conflicts / (double) (num_elements / lanes * state.iterations());
+
+    // Teardown
+    free(array);
+}
+
+/*
+ * BM_Prefetching reading its indexes from a compressed stream (see compression/index_stream.h) instead of index_array.
+ * The full index array only exists during setup, the timed loop decodes one block ahead of the one being gathered into
+ * a two block window, so the look-ahead prefetch PREFETCH_OFFSET elements away reads decoded indexes as well.
+ * Set against BM_Prefetching on the same pattern this shows how much of the indirect access is spent streaming the
+ * indexes in.
+ *   index_bytes_per_element: footprint of the compressed stream, 4 for the plain index array
+ *   compression_ratio:       plain index array bytes over compressed stream bytes
+ *   decode_ns_per_element:   one pass of the decoder alone, without the gather
+ */
+static_assert(PREFETCH_OFFSET < INDEX_STREAM_BLOCK_SIZE, "The decode window holds one block of look-ahead");
+
+template<bool is_software_prefetching_used>
+static void BM_Prefetching_Compressed(benchmark::State &state, access_patterns::Pattern pattern) {
+    // Setup
+    auto num_elements = state.range(0);
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    datasets::values(num_elements)->copy_to(array);
+    const auto stream = index_stream::encode(
+            datasets::indexes(pattern, num_elements, access_patterns::has_parameter(pattern) ? state.range(1) : 0)
+                    ->data(), num_elements);
+
+    // Block b is decoded into window[b % 2], the window past the last block stays zero for the look-ahead to read
+    alignas(64) int32_t window[2][INDEX_STREAM_BLOCK_SIZE] = {};
+    const auto num_blocks = stream.num_blocks();
+    auto decode_start = std::chrono::steady_clock::now();
+    for (int64_t block = 0; block < num_blocks; block++) {
+        index_stream::decode_block(stream, block, window[block % 2]);
+        benchmark::DoNotOptimize(window);
+    }
+    auto decode_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decode_start).count();
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        index_stream::decode_block(stream, 0, window[0]);
+        for (int64_t block = 0; block < num_blocks; block++) {
+            const int32_t *current = window[block % 2];
+            int32_t *next = window[(block + 1) % 2];
+            if (block + 1 < num_blocks) {
+                index_stream::decode_block(stream, block + 1, next);
+            } else {
+                memset(next, 0, sizeof(window[0]));
+            }
+            const int64_t length = std::min((int64_t) INDEX_STREAM_BLOCK_SIZE,
+                                            num_elements - block * INDEX_STREAM_BLOCK_SIZE);
+            for (int64_t x = 0; x < length; x++) {
+                if constexpr (is_software_prefetching_used) {
+                    const int64_t ahead = x + PREFETCH_OFFSET;
+                    __builtin_prefetch(&array[ahead < INDEX_STREAM_BLOCK_SIZE
+                                              ? current[ahead] : next[ahead - INDEX_STREAM_BLOCK_SIZE]]);
+                }
+                benchmark::DoNotOptimize(array[current[x]]++);
+            }
         }
+        counters.stop();
     }
+    counters.report(state);
+    data_generation::report(state);
+    state.counters["index_bytes_per_element"] = (double) stream.bytes() / (double) num_elements;
+    state.counters["compression_ratio"] = (double) (sizeof(int32_t) * num_elements) / (double) stream.bytes();
+    state.counters["decode_ns_per_element"] = decode_seconds * 1e9 / (double) num_elements;
 
     // Teardown
     free(array);
 }
 
-// Provides arguments in the range 1..100000, skewing the Hardwareproduced arguments towards 0
-static void CustomArguments(benchmark::internal::Benchmark *b) {
-    /*
-    for (int i = 1; i < std::min(10, MAX_NUM_ELEMENTS_IN_ARRAY); i+= 3)
-        b->Args({i});
-    for (int i = 10; i < std::min(100, MAX_NUM_ELEMENTS_IN_ARRAY); i+= 30)
-        b->Args({i});
-    for (int i = 100; i < std::min(1000, MAX_NUM_ELEMENTS_IN_ARRAY); i+= 300)
-        b->Args({i});
-    for (int i = 1000; i < std::min(10000, MAX_NUM_ELEMENTS_IN_ARRAY); i+= 3000)
-        b->Args({i});
-    for (int i = 10000; i < std::min(100000, MAX_NUM_ELEMENTS_IN_ARRAY); i+= 30000)
-        b->Args({i});
-    for (int i = 100000; i < std::min(1000000, MAX_NUM_ELEMENTS_IN_ARRAY); i+= 300000)
-        b->Args({i});
-    for (int i = 1000000; i < std::min(10000000, MAX_NUM_ELEMENTS_IN_ARRAY); i+= 3000000)
-        b->Args({i});
-    for (int i = 10000000; i < std::min(100000001, MAX_NUM_ELEMENTS_IN_ARRAY); i+= 30000000)
-        b->Args({i});
-        */
-    if constexpr(TESTING_SORTEDNESS) {
-        for (int x = 0; x <= 100; x += 10) {
-            b->Args({100000000, x});
+/*
+ * Autotuned variants of the kernels above.
+ * The prefetch distance is a runtime argument here rather than PREFETCH_OFFSET. Before timing starts the distance is
+ * searched for the exact arguments of the run (see autotuning/prefetch_distance.h), the timed loop then runs at the best
+ * distance found and the speedup curve of the search is reported as counters.
+ * A distance of 0 runs the kernel without any software prefetching.
+ */
+static void indirect_increment(int32_t *array, const int32_t *index_array, int64_t num_elements, int64_t distance) {
+    for (int64_t x = 0; x < num_elements; x++) {
+        if (distance) {
+            __builtin_prefetch(&array[index_array[x + distance]]);
+            __builtin_prefetch(&index_array[x + 2 * distance]);
+        }
+        benchmark::DoNotOptimize(array[index_array[x]]++);
+    }
+}
+
+static void strided_increment(int32_t *array, uint64_t num_elements, uint64_t stride_distance, int64_t distance) {
+    for (uint64_t x = 0; x < num_elements; x += stride_distance) {
+        if (distance) {
+            __builtin_prefetch(&array[x + (distance * stride_distance)]);
         }
-    } else if constexpr(RANDOM_INDEX_ARRAY_ADDITION) {
-        for (int x = 1; x < RANDOM_INDEX_ARRAY_ADDITION_RANGE_IN_ELEMENTS_MAX; x *= 2) {
-//            std::cout << x << std::endl;
-            b->Args({100000000, x});
+        benchmark::DoNotOptimize(array[x]++);
+    }
+}
+
+template<typename Kernel>
+static double time_pass(Kernel &&kernel) {
+    auto start = std::chrono::steady_clock::now();
+    kernel();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<bool is_cache_flushed>
+static void BM_Prefetching_Autotune(benchmark::State &state, access_patterns::Pattern pattern) {
+    // Setup
+    const auto max_distance = options::get_int("autotune_max_distance", AUTOTUNE_MAX_PREFETCH_DISTANCE);
+    auto num_elements = state.range(0);
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    datasets::values(num_elements)->copy_to(array);
+    // Padded so the look-ahead of the largest candidate distance stays in bounds
+    auto *index_array = (int32_t *) calloc(num_elements + 2 * max_distance, sizeof(int32_t));
+    datasets::indexes(pattern, num_elements, access_patterns::has_parameter(pattern) ? state.range(1) : 0)
+            ->copy_to(index_array);
+    const cache::Precondition precondition(is_cache_flushed ? cache::State::Cold : cache::State::Unmanaged,
+                                           {{array, sizeof(int32_t) * num_elements},
+                                            {index_array, sizeof(int32_t) * (num_elements + 2 * max_distance)}});
+
+    auto result = autotuning::search_prefetch_distance([&](int64_t distance) {
+        precondition.apply();
+        return time_pass([&] { indirect_increment(array, index_array, num_elements, distance); });
+    }, max_distance);
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        if constexpr (is_cache_flushed) {
+            state.PauseTiming();
+            precondition.apply();
+            state.ResumeTiming();
         }
-    } else if constexpr(RANDOM_STRIDE_FROM_PREVIOUS) {
-//        for (int x = 1; x < RANDOM_STRIDE_FROM_PREVIOUS_RANGE; x *= 2) {
-//            std::cout << x << std::endl;
-//            b->Args({100000000, x});
-//        }
-        std::cout << RANDOM_STRIDE_DISTANCE << std::endl;
-        b->Args({100000000, RANDOM_STRIDE_DISTANCE});
-
-    } else {
-        b->Args({100000000});
+        counters.start();
+        indirect_increment(array, index_array, num_elements, result.best_distance);
+        counters.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    autotuning::report(state, result);
+
+    // Teardown
+    free(index_array);
+    free(array);
+}
+
+static void BM_Large_Stride_Distance_Autotune(benchmark::State &state) {
+    // Setup
+    const auto max_distance = options::get_int("autotune_max_distance", AUTOTUNE_MAX_PREFETCH_DISTANCE);
+    const auto num_elements_orig = state.range(0);
+    const auto stride_distance = state.range(1);
+    uint64_t num_elements = num_elements_orig * stride_distance;
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    datasets::values(num_elements)->copy_to(array);
+
+    const cache::Precondition precondition(cache::State::Cold,
+                                           {{array, sizeof(int32_t) * num_elements,
+                                             sizeof(int32_t) * (size_t) stride_distance}});
+
+    auto result = autotuning::search_prefetch_distance([&](int64_t distance) {
+        precondition.apply();
+        return time_pass([&] { strided_increment(array, num_elements, stride_distance, distance); });
+    }, max_distance);
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        state.PauseTiming();
+        precondition.apply();
+        state.ResumeTiming();
+        counters.start();
+        strided_increment(array, num_elements, stride_distance, result.best_distance);
+        counters.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    autotuning::report(state, result);
+
+    // Teardown
+    free(array);
+}
+
+// Provides the element count plus, for patterns that take one, every value of the pattern's parameter grid
+static void CustomArguments(benchmark::internal::Benchmark *b, access_patterns::Pattern pattern, int64_t num_elements) {
+    if (!access_patterns::has_parameter(pattern)) {
+        b->ArgNames({"elements"});
+        b->Args({num_elements});
+        return;
+    }
+    b->ArgNames({"elements", access_patterns::parameter_name(pattern)});
+    for (auto parameter : access_patterns::grid(pattern)) {
+        b->Args({num_elements, parameter});
     }
 }
 
@@ -317,31 +478,130 @@ static void CustomArgumentsLargeStrideOffset(benchmark::internal::Benchmark *b)
     std::cout << "Finished processing input" << std::endl;
 }
 
+template<bool is_software_prefetching_used>
+static void register_pattern_benchmark(access_patterns::Pattern pattern, cache::State cache_state,
+                                       int64_t num_elements, int64_t iterations) {
+    for (auto allocator : allocators::selected()) {
+        std::string name = std::string("BM_Prefetching<") + access_patterns::name(pattern) + ", "
+                           + cache::name(cache_state) + ", "
+                           + (is_software_prefetching_used ? "true" : "false") + ", "
+                           + allocators::name(allocator) + ">";
+        auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Prefetching<is_software_prefetching_used>,
+                                               pattern, cache_state, allocator);
+        CustomArguments(b, pattern, num_elements);
+        b->Iterations(iterations);
+    }
+}
+
+template<bool is_software_prefetching_used>
+static void register_large_stride_benchmark(void (*arguments)(benchmark::internal::Benchmark *)) {
+    for (auto allocator : allocators::selected()) {
+        std::string name = std::string("BM_Large_Stride_Distance<")
+                           + (is_software_prefetching_used ? "true" : "false") + ", "
+                           + allocators::name(allocator) + ">";
+        benchmark::RegisterBenchmark(name.c_str(), BM_Large_Stride_Distance<is_software_prefetching_used>, allocator)
+                ->Apply(arguments)->Iterations(100);
+    }
+}
+
+template<bool is_software_prefetching_used>
+static void register_simd_benchmark(access_patterns::Pattern pattern, simd_gather::Isa isa, int64_t num_elements,
+                                    int64_t iterations) {
+    std::string name = std::string("BM_Prefetching_Simd<") + access_patterns::name(pattern) + ", "
+                       + simd_gather::name(isa) + ", " + (is_software_prefetching_used ? "true" : "false") + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Prefetching_Simd<is_software_prefetching_used>,
+                                           pattern, isa);
+    CustomArguments(b, pattern, num_elements);
+    b->Iterations(iterations);
+}
+
+template<bool is_software_prefetching_used>
+static void register_compressed_benchmark(access_patterns::Pattern pattern, int64_t num_elements, int64_t iterations) {
+    std::string name = std::string("BM_Prefetching_Compressed<") + access_patterns::name(pattern) + ", "
+                       + (is_software_prefetching_used ? "true" : "false") + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Prefetching_Compressed<is_software_prefetching_used>,
+                                           pattern);
+    CustomArguments(b, pattern, num_elements);
+    b->Iterations(iterations);
+}
+
+template<bool is_cache_flushed>
+static void register_autotune_benchmark(access_patterns::Pattern pattern, int64_t num_elements, int64_t iterations) {
+    std::string name = std::string("BM_Prefetching_Autotune<") + access_patterns::name(pattern) + ", "
+                       + (is_cache_flushed ? "true" : "false") + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Prefetching_Autotune<is_cache_flushed>, pattern);
+    CustomArguments(b, pattern, num_elements);
+    b->Iterations(iterations);
+}
+
 void prefetching::register_benchmarks() {
     std::cerr << "Prefetch distance is: " << PREFETCH_OFFSET << std::endl;
-    // Iterate over all of the possible combinations of the template
-    if constexpr (TESTING_EFFECTS_OF_CACHE_FLUSHING) {
-        // Add tests where the cache is not flushed
-        BENCHMARK_TEMPLATE(BM_Prefetching, false, false, false)->Apply(CustomArguments)->Iterations(
-                REPETITIONS_OF_EXPERIMENTS);
-        BENCHMARK_TEMPLATE(BM_Prefetching, true, false, false)->Apply(CustomArguments)->Iterations(
-                REPETITIONS_OF_EXPERIMENTS);
-        BENCHMARK_TEMPLATE(BM_Prefetching, true, false, true)->Apply(CustomArguments)->Iterations(
-                REPETITIONS_OF_EXPERIMENTS);
-        BENCHMARK_TEMPLATE(BM_Prefetching, false, false, true)->Apply(CustomArguments)->Iterations(
-                REPETITIONS_OF_EXPERIMENTS);
+    const auto num_elements = options::get_int("prefetching_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto iterations = options::get_int("prefetching_iterations", REPETITIONS_OF_EXPERIMENTS);
+    const bool flush_cache = options::get_bool("prefetching_flush_cache", TESTING_EFFECTS_OF_CACHE_FLUSHING);
+    const bool autotune = options::get_bool("prefetching_autotune", AUTOTUNE_PREFETCH_DISTANCE);
+    const bool compressed = options::get_bool("prefetching_compressed", TESTING_COMPRESSED_INDEXES);
+    std::vector<cache::State> cache_states;
+    std::vector<std::string> default_cache_states = {"unmanaged"};
+    if (flush_cache) {
+        default_cache_states.emplace_back("cold");
+    }
+    for (const auto &state_name : options::get_string_list("prefetching_cache_states", default_cache_states)) {
+        cache::State cache_state;
+        if (!cache::from_name(state_name, &cache_state)) {
+            std::cerr << "Unknown cache state: " << state_name << std::endl;
+            continue;
+        }
+        cache_states.push_back(cache_state);
+    }
+    std::vector<simd_gather::Isa> simd_isas;
+    for (const auto &isa_name : options::get_string_list("prefetching_simd_isas", {"avx2", "avx512"})) {
+        simd_gather::Isa isa;
+        if (!simd_gather::from_name(isa_name, &isa)) {
+            std::cerr << "Unknown SIMD ISA: " << isa_name << std::endl;
+            continue;
+        }
+        simd_isas.push_back(isa);
     }
-    // Add all tests where the cache is flushed
-//    BENCHMARK_TEMPLATE(BM_Prefetching, false, true, false)->Apply(CustomArguments)->MinTime(0.0001);
-//    BENCHMARK_TEMPLATE(BM_Prefetching, false, true, false)->Apply(CustomArguments)->MinTime(0.0001);
-
-//    BENCHMARK_TEMPLATE(BM_Prefetching, true, true, false)->Apply(CustomArguments)->MinTime(0.0001);
-//    BENCHMARK_TEMPLATE(BM_Prefetching, true, true, true)->Apply(CustomArguments)->MinTime(0.0001);
 
+    // Every selected access pattern gets its own family, swept with and without software prefetching
+    std::vector<std::string> all_pattern_names;
+    for (auto pattern : access_patterns::all()) {
+        all_pattern_names.emplace_back(access_patterns::name(pattern));
+    }
+    for (const auto &pattern_name : options::get_string_list("prefetching_patterns", all_pattern_names)) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        for (auto cache_state : cache_states) {
+            register_pattern_benchmark<false>(pattern, cache_state, num_elements, iterations);
+            register_pattern_benchmark<true>(pattern, cache_state, num_elements, iterations);
+        }
+        for (auto isa : simd_isas) {
+            register_simd_benchmark<false>(pattern, isa, num_elements, iterations);
+            register_simd_benchmark<true>(pattern, isa, num_elements, iterations);
+        }
+        if (compressed) {
+            register_compressed_benchmark<false>(pattern, num_elements, iterations);
+            register_compressed_benchmark<true>(pattern, num_elements, iterations);
+        }
+        if (autotune) {
+            register_autotune_benchmark<false>(pattern, num_elements, iterations);
+            if (flush_cache) {
+                register_autotune_benchmark<true>(pattern, num_elements, iterations);
+            }
+        }
+    }
 
-    // Large stride analysis
-    BENCHMARK_TEMPLATE(BM_Large_Stride_Distance, false)->Apply(CustomArgumentsLargeStride)->Iterations(100);
-    BENCHMARK_TEMPLATE(BM_Large_Stride_Distance, true)->Apply(CustomArgumentsLargeStride)->Iterations(100);
-    BENCHMARK_TEMPLATE(BM_Large_Stride_Distance, false)->Apply(CustomArgumentsLargeStrideOffset)->Iterations(100);
-    BENCHMARK_TEMPLATE(BM_Large_Stride_Distance, true)->Apply(CustomArgumentsLargeStrideOffset)->Iterations(100);
-}
\ No newline at end of file
+    // Large stride analysis, repeated for every allocator selected with --allocators
+    register_large_stride_benchmark<false>(CustomArgumentsLargeStride);
+    register_large_stride_benchmark<true>(CustomArgumentsLargeStride);
+    register_large_stride_benchmark<false>(CustomArgumentsLargeStrideOffset);
+    register_large_stride_benchmark<true>(CustomArgumentsLargeStrideOffset);
+    if (autotune) {
+        BENCHMARK(BM_Large_Stride_Distance_Autotune)->Apply(CustomArgumentsLargeStride)->Iterations(100);
+        BENCHMARK(BM_Large_Stride_Distance_Autotune)->Apply(CustomArgumentsLargeStrideOffset)->Iterations(100);
+    }
+}
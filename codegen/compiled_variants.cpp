@@ -0,0 +1,166 @@
+#include "compiled_variants.h"
+#include <algorithm>
+#include <iostream>
+#include "variants.h"
+#include "../access_patterns/access_patterns.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/options.h"
+#include "../instrumentation/perf_counters.h"
+
+// Tunable parameters
+#define PREFETCH_OFFSET 64 // Same look-ahead as kernels.cpp
+#define NUM_AGGREGATION_ELEMENTS 10000000 // Same input size as BM_Clusteredness
+#define NUM_ELEMENTS_IN_EXPERIMENTS 16777216 // --codegen_elements, elements of the gather
+#define REPETITIONS_OF_EXPERIMENTS 10 // --codegen_iterations
+
+static_assert(2 * PREFETCH_OFFSET <= DATASET_PADDING, "The look-ahead reads past the end of the indexes");
+
+/*
+ * The kernels of codegen/kernels.cpp once per compiled variant (see codegen/variants.h), so that one run compares the
+ * code generation strategies directly instead of one rebuild per CMAKE_CXX_FLAGS.
+ *   BM_Codegen_Aggregate<variant>:        the clusteredness filter over the selectivity x clusteredness grid, where
+ *                                         if-conversion (or vectorisation) decides whether mispredictions matter
+ *   BM_Codegen_Gather<variant, prefetch>: the BM_Prefetching kernel per access pattern
+ * The label of every benchmark holds the flags its variant was compiled with.
+ */
+static bool check_supported(benchmark::State &state, const codegen::Variant *variant) {
+    if (variant->supported()) {
+        return true;
+    }
+    state.SkipWithError((std::string(variant->name) + " was compiled for an ISA this CPU does not have").c_str());
+    return false;
+}
+
+static void BM_Codegen_Aggregate(benchmark::State &state, const codegen::Variant *variant) {
+    if (!check_supported(state, variant)) {
+        return;
+    }
+
+    // Setup
+    const double selectivity = (double) state.range(0) / 100.0;
+    const double clusteredness = (double) state.range(1) / 100.0;
+    const auto pivot = (uint32_t) (RAND_MAX * selectivity);
+    auto *array = (uint32_t *) malloc(sizeof(uint32_t) * NUM_AGGREGATION_ELEMENTS);
+    data_generation::fill_clustered(array, NUM_AGGREGATION_ELEMENTS,
+                                    data_generation::Random(data_generation::Stream::Clustering), clusteredness);
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        benchmark::DoNotOptimize(variant->aggregate(array, NUM_AGGREGATION_ELEMENTS, pivot));
+        counters.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    state.SetLabel(variant->flags);
+
+    // Teardown
+    free(array);
+}
+
+template<bool is_software_prefetching_used>
+static void BM_Codegen_Gather(benchmark::State &state, const codegen::Variant *variant,
+                              access_patterns::Pattern pattern) {
+    if (!check_supported(state, variant)) {
+        return;
+    }
+
+    // Setup
+    const auto num_elements = state.range(0);
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    datasets::values(num_elements)->copy_to(array);
+    // The indexes are only read, the shared dataset's padding holds the look-ahead of 2 * PREFETCH_OFFSET elements
+    const auto indexes = datasets::indexes(pattern, num_elements,
+                                           access_patterns::has_parameter(pattern) ? state.range(1) : 0);
+    const int32_t *index_array = indexes->data();
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        if constexpr (is_software_prefetching_used) {
+            variant->gather_prefetch(array, index_array, num_elements);
+        } else {
+            variant->gather(array, index_array, num_elements);
+        }
+        counters.stop();
+        benchmark::ClobberMemory();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    state.SetLabel(variant->flags);
+
+    // Teardown
+    free(array);
+}
+
+// Provides the element count plus, for patterns that take one, every value of the pattern's parameter grid
+static void CustomArguments(benchmark::internal::Benchmark *b, access_patterns::Pattern pattern, int64_t num_elements) {
+    if (!access_patterns::has_parameter(pattern)) {
+        b->ArgNames({"elements"});
+        b->Args({num_elements});
+        return;
+    }
+    b->ArgNames({"elements", access_patterns::parameter_name(pattern)});
+    for (auto parameter : access_patterns::grid(pattern)) {
+        b->Args({num_elements, parameter});
+    }
+}
+
+template<bool is_software_prefetching_used>
+static void register_gather(const codegen::Variant *variant, access_patterns::Pattern pattern, int64_t num_elements,
+                            int64_t iterations) {
+    std::string name = std::string("BM_Codegen_Gather<") + variant->name + ", " + access_patterns::name(pattern)
+                       + ", " + (is_software_prefetching_used ? "true" : "false") + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Codegen_Gather<is_software_prefetching_used>, variant,
+                                           pattern);
+    CustomArguments(b, pattern, num_elements);
+    b->Iterations(iterations);
+}
+
+void compiled_variants::register_benchmarks() {
+    const auto num_elements = options::get_int("codegen_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto iterations = options::get_int("codegen_iterations", REPETITIONS_OF_EXPERIMENTS);
+    const auto selectivities = options::get_int_list("codegen_selectivities", {10, 50, 90});
+    const auto clusteredness = options::get_int_list("codegen_clusteredness", {0, 90, 99});
+    std::vector<access_patterns::Pattern> patterns;
+    for (const auto &pattern_name : options::get_string_list("codegen_patterns", {"sequential", "shuffled"})) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        patterns.push_back(pattern);
+    }
+
+    std::vector<std::string> all_variant_names;
+    for (const auto *variant : codegen::all()) {
+        all_variant_names.emplace_back(variant->name);
+    }
+    for (const auto &variant_name : options::get_string_list("codegen_variants", all_variant_names)) {
+        auto found = std::find_if(codegen::all().begin(), codegen::all().end(),
+                                  [&](const codegen::Variant *variant) { return variant_name == variant->name; });
+        if (found == codegen::all().end()) {
+            std::cerr << "Unknown code generation variant: " << variant_name << std::endl;
+            continue;
+        }
+        const codegen::Variant *variant = *found;
+
+        std::string name = std::string("BM_Codegen_Aggregate<") + variant->name + ">";
+        auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Codegen_Aggregate, variant);
+        b->ArgNames({"selectivity", "clusteredness"});
+        for (auto selectivity : selectivities) {
+            for (auto cluster : clusteredness) {
+                b->Args({selectivity, cluster});
+            }
+        }
+        b->Iterations(iterations);
+
+        for (auto pattern : patterns) {
+            register_gather<false>(variant, pattern, num_elements, iterations);
+            register_gather<true>(variant, pattern, num_elements, iterations);
+        }
+    }
+}
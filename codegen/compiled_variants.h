@@ -0,0 +1,10 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_COMPILED_VARIANTS_H
+#define OPTIMIZATION_TESTING_GROUND_COMPILED_VARIANTS_H
+
+#include <benchmark/benchmark.h>
+
+namespace compiled_variants {
+    void register_benchmarks();
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_COMPILED_VARIANTS_H
@@ -0,0 +1,60 @@
+#include "variants.h"
+
+/*
+ * Compiled once per code generation variant, with CODEGEN_NAME and CODEGEN_FLAGS defined by add_codegen_variant.
+ * Everything stays in an anonymous namespace so the copies do not clash, see variants.h for what may be used here.
+ */
+#ifndef CODEGEN_NAME
+#error "kernels.cpp is only built through add_codegen_variant"
+#endif
+
+#define PREFETCH_OFFSET 64 // Same look-ahead as BM_Prefetching in prefetching.cpp
+
+namespace {
+    bool supported() {
+#if defined(__AVX512F__)
+        if (!__builtin_cpu_supports("avx512f")) {
+            return false;
+        }
+#endif
+#if defined(__AVX2__)
+        if (!__builtin_cpu_supports("avx2")) {
+            return false;
+        }
+#endif
+#if defined(__AVX__)
+        if (!__builtin_cpu_supports("avx")) {
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    uint64_t aggregate(const uint32_t *array, int64_t num_elements, uint32_t pivot) {
+        uint64_t sum = 0;
+        for (int64_t x = 0; x < num_elements; x++) {
+            if (array[x] < pivot) {
+                sum += array[x];
+            }
+        }
+        return sum;
+    }
+
+    void gather(int32_t *array, const int32_t *index_array, int64_t num_elements) {
+        for (int64_t x = 0; x < num_elements; x++) {
+            array[index_array[x]]++;
+        }
+    }
+
+    void gather_prefetch(int32_t *array, const int32_t *index_array, int64_t num_elements) {
+        for (int64_t x = 0; x < num_elements; x++) {
+            __builtin_prefetch(&array[index_array[x + PREFETCH_OFFSET]]);
+            __builtin_prefetch(&index_array[x + 2 * PREFETCH_OFFSET]);
+            array[index_array[x]]++;
+        }
+    }
+
+    // Constant initialised, the only code run at startup is the call into the registrar
+    const codegen::Variant variant = {CODEGEN_NAME, CODEGEN_FLAGS, supported, aggregate, gather, gather_prefetch};
+    const codegen::Registrar registrar(&variant);
+}
@@ -0,0 +1,14 @@
+#include "variants.h"
+
+static std::vector<const codegen::Variant *> &registry() {
+    static std::vector<const codegen::Variant *> variants;
+    return variants;
+}
+
+codegen::Registrar::Registrar(const Variant *variant) {
+    registry().push_back(variant);
+}
+
+const std::vector<const codegen::Variant *> &codegen::all() {
+    return registry();
+}
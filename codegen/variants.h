@@ -0,0 +1,39 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_VARIANTS_H
+#define OPTIMIZATION_TESTING_GROUND_VARIANTS_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * The same kernels compiled several times over, each copy under its own code generation flags.
+ *
+ * codegen/kernels.cpp is built once per variant as an object library (see add_codegen_variant in CMakeLists.txt) and
+ * linked into optimization_testing_ground next to the rest, so one binary holds e.g. an -O2, an -O3, an -O3 without
+ * if-conversion and an -O3 -march=native copy of every kernel. Each copy adds itself to all() from a static initializer
+ * with the name and flags it was built with.
+ *
+ * Kernels must stay self contained: no templates or inline functions from headers, as the linker keeps a single copy
+ * of those for the whole program, which could then be one compiled for a newer -march than the CPU has.
+ */
+namespace codegen {
+    struct Variant {
+        const char *name;
+        const char *flags;
+        bool (*supported)(); // false when the variant was compiled for an ISA this CPU lacks
+
+        // if (array[x] < pivot) sum += array[x], the selectivity filter of clusteredness.cpp
+        uint64_t (*aggregate)(const uint32_t *array, int64_t num_elements, uint32_t pivot);
+        // array[index_array[x]]++, the BM_Prefetching kernel, with and without the look-ahead prefetch
+        void (*gather)(int32_t *array, const int32_t *index_array, int64_t num_elements);
+        void (*gather_prefetch)(int32_t *array, const int32_t *index_array, int64_t num_elements);
+    };
+
+    struct Registrar {
+        explicit Registrar(const Variant *variant);
+    };
+
+    // Every variant linked in, in link order
+    const std::vector<const Variant *> &all();
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_VARIANTS_H
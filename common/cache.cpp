@@ -0,0 +1,195 @@
+#include "cache.h"
+#include <algorithm>
+#include <cpuid.h>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <immintrin.h>
+#include "../instrumentation/tracing.h"
+
+// Used when neither sysfs nor cpuid describe a level
+#define DEFAULT_LINE_SIZE 64
+#define DEFAULT_L1D_SIZE (32 * 1024)
+#define DEFAULT_L2_SIZE (1024 * 1024)
+#define DEFAULT_LLC_SIZE (32 * 1024 * 1024)
+
+// Parses sysfs cache sizes such as "48K" or "30M"
+static size_t parse_size(const std::string &text) {
+    size_t size = strtoull(text.c_str(), nullptr, 10);
+    switch (text.empty() ? ' ' : text.back()) {
+        case 'K':
+            return size * 1024;
+        case 'M':
+            return size * 1024 * 1024;
+        case 'G':
+            return size * 1024 * 1024 * 1024;
+        default:
+            return size;
+    }
+}
+
+static bool read_sysfs(cache::Topology *topology) {
+    bool found = false;
+    for (int index = 0;; index++) {
+        std::string directory = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        std::ifstream level_file(directory + "level"), type_file(directory + "type"), size_file(directory + "size"),
+                line_file(directory + "coherency_line_size");
+        int level;
+        std::string type, size;
+        size_t line_size;
+        if (!(level_file >> level) || !(type_file >> type) || !(size_file >> size)) {
+            return found;
+        }
+        if (type == "Instruction") {
+            continue;
+        }
+        if (line_file >> line_size) {
+            topology->line_size = line_size;
+        }
+        if (level == 1) {
+            topology->l1d_bytes = parse_size(size);
+        } else if (level == 2) {
+            topology->l2_bytes = parse_size(size);
+        }
+        // The highest level seen is the LLC
+        topology->llc_bytes = parse_size(size);
+        found = true;
+    }
+}
+
+// Deterministic cache parameters, leaf 4 on Intel and 0x8000001D on AMD share a layout
+static bool read_cpuid(cache::Topology *topology) {
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int leaf = 4;
+    if (__get_cpuid(0, &eax, &ebx, &ecx, &edx) && ebx == 0x68747541) { // "Auth"enticAMD
+        leaf = 0x8000001D;
+    }
+    bool found = false;
+    for (unsigned int subleaf = 0; __get_cpuid_count(leaf, subleaf, &eax, &ebx, &ecx, &edx); subleaf++) {
+        unsigned int type = eax & 0x1f;
+        if (type == 0) {
+            break;
+        }
+        if (type == 2) { // Instruction cache
+            continue;
+        }
+        unsigned int level = (eax >> 5) & 0x7;
+        size_t line_size = (ebx & 0xfff) + 1;
+        size_t size = (((ebx >> 22) & 0x3ff) + 1) * (((ebx >> 12) & 0x3ff) + 1) * line_size * ((size_t) ecx + 1);
+        topology->line_size = line_size;
+        if (level == 1) {
+            topology->l1d_bytes = size;
+        } else if (level == 2) {
+            topology->l2_bytes = size;
+        }
+        topology->llc_bytes = size;
+        found = true;
+    }
+    return found;
+}
+
+const cache::Topology &cache::topology() {
+    static const Topology topology = [] {
+        Topology result = {DEFAULT_LINE_SIZE, DEFAULT_L1D_SIZE, DEFAULT_L2_SIZE, DEFAULT_LLC_SIZE};
+        if (!read_sysfs(&result)) {
+            read_cpuid(&result);
+        }
+        return result;
+    }();
+    return topology;
+}
+
+const char *cache::name(State state) {
+    switch (state) {
+        case State::Unmanaged:
+            return "unmanaged";
+        case State::Cold:
+            return "cold";
+        case State::WarmLlc:
+            return "warm_llc";
+        case State::WarmL2:
+            return "warm_l2";
+        case State::WarmL1:
+            return "warm_l1";
+    }
+    return "unknown";
+}
+
+bool cache::from_name(const std::string &name, State *state) {
+    for (auto candidate : {State::Unmanaged, State::Cold, State::WarmLlc, State::WarmL2, State::WarmL1}) {
+        if (name == cache::name(candidate)) {
+            *state = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+__attribute__((target("clflushopt")))
+static void flush_lines_opt(const char *begin, const char *end, size_t stride) {
+    for (const char *line = begin; line < end; line += stride) {
+        _mm_clflushopt((void *) line);
+    }
+}
+
+static void flush_lines(const char *begin, const char *end, size_t stride) {
+    for (const char *line = begin; line < end; line += stride) {
+        _mm_clflush(line);
+    }
+}
+
+static void read_lines(const char *begin, const char *end, size_t stride) {
+    char sink = 0;
+    for (const char *line = begin; line < end; line += stride) {
+        sink ^= *(const volatile char *) line;
+    }
+    asm volatile("" : : "r"(sink));
+}
+
+// Reads twice the size of a level through it, which pushes the benchmark's lines out to the level below
+static void evict(std::vector<char> &eviction_buffer, size_t level_bytes) {
+    if (eviction_buffer.empty()) {
+        eviction_buffer.assign(2 * level_bytes, 1);
+    }
+    read_lines(eviction_buffer.data(), eviction_buffer.data() + eviction_buffer.size(), cache::topology().line_size);
+}
+
+cache::Precondition::Precondition(State state, std::vector<Buffer> buffers)
+        : requested(state), buffers(std::move(buffers)) {
+    const size_t line_size = topology().line_size;
+    for (auto &buffer : this->buffers) {
+        buffer.stride_bytes = std::max(line_size, buffer.stride_bytes);
+    }
+}
+
+void cache::Precondition::apply() const {
+    if (requested == State::Unmanaged) {
+        return;
+    }
+    const tracing::Scope scope(name(requested), "precondition");
+    static const bool has_clflushopt = __builtin_cpu_supports("clflushopt");
+    static std::vector<char> l1d_eviction, l2_eviction;
+    const size_t line_size = topology().line_size;
+    for (const auto &buffer : buffers) {
+        // Dense buffers are walked from the line holding their first byte so that the last, partial line is included,
+        // strided ones from the first element the kernel touches
+        auto *begin = buffer.stride_bytes == line_size
+                      ? (const char *) ((uintptr_t) buffer.memory & ~(uintptr_t) (line_size - 1))
+                      : (const char *) buffer.memory;
+        auto *end = (const char *) buffer.memory + buffer.bytes;
+        if (requested == State::Cold) {
+            has_clflushopt ? flush_lines_opt(begin, end, buffer.stride_bytes)
+                           : flush_lines(begin, end, buffer.stride_bytes);
+        } else {
+            read_lines(begin, end, buffer.stride_bytes);
+        }
+    }
+    if (requested == State::Cold) {
+        // clflushopt is only ordered by a fence, the timed loop must not start before the flushes complete
+        _mm_sfence();
+    } else if (requested == State::WarmLlc) {
+        evict(l2_eviction, topology().l2_bytes);
+    } else if (requested == State::WarmL2) {
+        evict(l1d_eviction, topology().l1d_bytes);
+    }
+}
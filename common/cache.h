@@ -0,0 +1,68 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_CACHE_H
+#define OPTIMIZATION_TESTING_GROUND_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Cache state control for the timed loops.
+ * Sizes come from sysfs (/sys/devices/system/cpu/cpu0/cache), or from cpuid leaf 4 / 0x8000001D when sysfs is not
+ * available, rather than being assumed.
+ *
+ * A benchmark declares which of its buffers the kernel reads and the state they should be in when a pass starts, then
+ * calls apply() before every pass:
+ *   Unmanaged: nothing is done, whatever the previous pass left behind
+ *   Cold:      every line of the buffers is flushed with clflushopt (clflush on older CPUs), the cost scales with the
+ *              buffers rather than with the LLC and eviction is guaranteed whatever the LLC size
+ *   WarmLlc:   the buffers are read, then a buffer twice the size of the L2 is read to push them out of L1 and L2
+ *   WarmL2:    as above with a buffer twice the size of the L1 data cache
+ *   WarmL1:    the buffers are read, so what fits of their tail is in L1
+ * Buffers larger than the level they are warmed into only have their tail resident, as with any real working set.
+ */
+namespace cache {
+    struct Topology {
+        size_t line_size;
+        size_t l1d_bytes;
+        size_t l2_bytes;
+        size_t llc_bytes;
+    };
+
+    const Topology &topology();
+
+    enum class State {
+        Unmanaged,
+        Cold,
+        WarmLlc,
+        WarmL2,
+        WarmL1,
+    };
+
+    const char *name(State state);
+    bool from_name(const std::string &name, State *state);
+
+    struct Buffer {
+        const void *memory;
+        size_t bytes;
+        // Distance between the elements the kernel touches, strided kernels only need those lines flushed or read
+        size_t stride_bytes = 0;
+    };
+
+    class Precondition {
+    public:
+        Precondition(State state, std::vector<Buffer> buffers);
+
+        // Puts the buffers into the requested state, call before every timed pass
+        void apply() const;
+
+        State state() const {
+            return requested;
+        }
+
+    private:
+        State requested;
+        std::vector<Buffer> buffers;
+    };
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_CACHE_H
@@ -0,0 +1,139 @@
+#include "data_generation.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "options.h"
+#include "../instrumentation/tracing.h"
+
+#define GENERATION_CHUNK_SIZE (256 * 1024) // Elements per unit of work, fixed so the output never depends on threads
+#define PERMUTATION_ROUNDS 4
+
+static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// 32 bits so that the seed survives being reported through a double counter
+// The console reporter rounds counters to a few digits, so the exact value is printed once as well
+uint64_t data_generation::seed() {
+    static const uint64_t seed = [] {
+        uint64_t chosen = options::has("seed")
+                          ? (uint64_t) options::get_int("seed", 0)
+                          : (uint64_t) std::random_device()();
+        std::cerr << "Data generation seed: " << chosen << std::endl;
+        return chosen;
+    }();
+    return seed;
+}
+
+data_generation::Random::Random(Stream stream, uint64_t salt)
+        : key(mix(seed() ^ mix(((uint64_t) stream << 48) + salt))) {
+}
+
+void data_generation::parallel_for(int64_t num_elements,
+                                   const std::function<void(int64_t begin, int64_t end)> &chunk) {
+    const int64_t num_chunks = (num_elements + GENERATION_CHUNK_SIZE - 1) / GENERATION_CHUNK_SIZE;
+    const int64_t num_threads = std::min(num_chunks, options::get_int("generation_threads",
+                                                                      std::thread::hardware_concurrency()));
+    std::atomic<int64_t> next_chunk(0);
+    auto work = [&] {
+        const tracing::Scope scope("generation_thread", "setup");
+        for (int64_t c = next_chunk++; c < num_chunks; c = next_chunk++) {
+            chunk(c * GENERATION_CHUNK_SIZE, std::min(num_elements, (c + 1) * GENERATION_CHUNK_SIZE));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int64_t t = 1; t < num_threads; t++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void data_generation::fill_uniform(int32_t *array, int64_t num_elements, const Random &random) {
+    const tracing::Scope scope("fill_uniform", "setup");
+    parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+        for (int64_t x = begin; x < end; x++) {
+            array[x] = (int32_t) random.value(x);
+        }
+    });
+}
+
+void data_generation::fill_uniform(uint32_t *array, int64_t num_elements, const Random &random) {
+    fill_uniform((int32_t *) array, num_elements, random);
+}
+
+/*
+ * Element x repeats its predecessor when draw 2x says so and is random.value(2x + 1) otherwise.
+ * Every chunk is filled from its first new value onwards in parallel, the elements before that repeat the end of the
+ * previous chunk and are filled in chunk order afterwards.
+ */
+void data_generation::fill_clustered(uint32_t *array, int64_t num_elements, const Random &random,
+                                     double repeat_probability) {
+    const tracing::Scope scope("fill_clustered", "setup");
+    const int64_t num_chunks = (num_elements + GENERATION_CHUNK_SIZE - 1) / GENERATION_CHUNK_SIZE;
+    std::vector<int64_t> first_new_value(num_chunks);
+    parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+        int64_t x = begin;
+        while (x < end && random.chance(2 * x, repeat_probability)) {
+            x++;
+        }
+        first_new_value[begin / GENERATION_CHUNK_SIZE] = x;
+        uint32_t previous = 0;
+        for (; x < end; x++) {
+            previous = random.chance(2 * x, repeat_probability) ? previous : random.value(2 * x + 1);
+            array[x] = previous;
+        }
+    });
+
+    uint32_t previous = random.value(~0ull);
+    for (int64_t c = 0; c < num_chunks; c++) {
+        int64_t begin = c * GENERATION_CHUNK_SIZE;
+        int64_t end = std::min(num_elements, begin + GENERATION_CHUNK_SIZE);
+        std::fill(&array[begin], &array[first_new_value[c]], previous);
+        previous = array[end - 1];
+    }
+}
+
+/*
+ * A balanced Feistel network is a bijection on [0, 2^(2 * half_bits)) for any round function, the domain is the
+ * smallest such power of 4 that holds num_elements. Values that land outside [0, num_elements) are fed through again
+ * (cycle walking), which ends inside it as the walk follows a cycle of the bijection that contains the start.
+ */
+void data_generation::fill_permutation(int32_t *array, int64_t num_elements, const Random &random) {
+    const tracing::Scope scope("fill_permutation", "setup");
+    int bits = 2;
+    while (((int64_t) 1 << bits) < num_elements) {
+        bits++;
+    }
+    const int half_bits = (bits + 1) / 2;
+    const uint64_t half_mask = ((uint64_t) 1 << half_bits) - 1;
+
+    parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+        for (int64_t x = begin; x < end; x++) {
+            uint64_t value = x;
+            do {
+                uint64_t left = value >> half_bits;
+                uint64_t right = value & half_mask;
+                for (uint64_t round = 0; round < PERMUTATION_ROUNDS; round++) {
+                    uint64_t next = left ^ (random.bits((round << 32) | right) & half_mask);
+                    left = right;
+                    right = next;
+                }
+                value = (left << half_bits) | right;
+            } while (value >= (uint64_t) num_elements);
+            array[x] = (int32_t) value;
+        }
+    });
+}
+
+void data_generation::report(benchmark::State &state) {
+    state.counters["seed"] = (double) seed();
+}
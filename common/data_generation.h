@@ -0,0 +1,85 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_DATA_GENERATION_H
+#define OPTIMIZATION_TESTING_GROUND_DATA_GENERATION_H
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <functional>
+
+/*
+ * Setup data for the benchmarks.
+ * rand() is a locked, sequential generator seeded from time(NULL), so filling a 100M element array with it is slower
+ * than the measured loop, cannot be split across threads and is different on every run.
+ *
+ * Instead every value is a pure function of (seed, stream, counter): the counter is the element's index, and the value
+ * is the SplitMix64 finalizer applied to it. No state is carried from one element to the next, so fills vectorise, are
+ * split into fixed size chunks across --generation_threads threads and give identical arrays for a given seed
+ * whatever the thread count.
+ *
+ * The seed is --seed, or a random one picked once per process. report() records it as the "seed" counter so that any
+ * result can be regenerated with --seed=<value>.
+ */
+namespace data_generation {
+    // Independent sequences for the different consumers, so that e.g. the values and the indexes of one benchmark are
+    // not correlated
+    enum class Stream : uint64_t {
+        Values = 1,
+        Indexes,
+        Clustering,
+        Calibration,
+        Links,
+        Layout,
+        Lookups,
+        Schedule,
+    };
+
+    uint64_t seed();
+
+    class Random {
+    public:
+        // salt separates several sequences of the same stream, e.g. one per segment of an array
+        explicit Random(Stream stream, uint64_t salt = 0);
+
+        inline uint64_t bits(uint64_t counter) const {
+            uint64_t z = key + counter * 0x9E3779B97F4A7C15ull;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // Uniform in [0, RAND_MAX], the same range rand() had
+        inline uint32_t value(uint64_t counter) const {
+            return (uint32_t) (bits(counter) >> 33);
+        }
+
+        // Uniform in [0, bound), by multiply and shift rather than modulo
+        inline uint64_t below(uint64_t counter, uint64_t bound) const {
+            return (uint64_t) (((unsigned __int128) bits(counter) * bound) >> 64);
+        }
+
+        // true with the given probability
+        inline bool chance(uint64_t counter, double probability) const {
+            return (double) (bits(counter) >> 11) * 0x1.0p-53 < probability;
+        }
+
+    private:
+        uint64_t key;
+    };
+
+    // Calls chunk(begin, end) over [0, num_elements) in fixed size chunks spread over the generation threads
+    void parallel_for(int64_t num_elements, const std::function<void(int64_t begin, int64_t end)> &chunk);
+
+    // array[x] = random.value(x)
+    void fill_uniform(int32_t *array, int64_t num_elements, const Random &random);
+    void fill_uniform(uint32_t *array, int64_t num_elements, const Random &random);
+
+    // Each element repeats the preceding one with probability repeat_probability, otherwise it is a new uniform value
+    void fill_clustered(uint32_t *array, int64_t num_elements, const Random &random, double repeat_probability);
+
+    // A random permutation of [0, num_elements), computed per element through a Feistel network
+    void fill_permutation(int32_t *array, int64_t num_elements, const Random &random);
+
+    // Adds the seed counter to the benchmark's output
+    void report(benchmark::State &state);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_DATA_GENERATION_H
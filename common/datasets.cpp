@@ -0,0 +1,175 @@
+#include "datasets.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include "data_generation.h"
+#include "options.h"
+#include "../instrumentation/tracing.h"
+
+namespace {
+    struct Entry {
+        std::shared_ptr<const datasets::Dataset> dataset;
+        size_t bytes;
+        uint64_t last_use;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, Entry> cache;
+    size_t cached_bytes = 0;
+    uint64_t uses = 0;
+
+    void evict(size_t budget) {
+        while (cached_bytes > budget && !cache.empty()) {
+            auto oldest = cache.begin();
+            for (auto it = cache.begin(); it != cache.end(); it++) {
+                if (it->second.last_use < oldest->second.last_use) {
+                    oldest = it;
+                }
+            }
+            cached_bytes -= oldest->second.bytes;
+            cache.erase(oldest);
+        }
+    }
+
+    // Maps a file written by an earlier run, nullptr when there is none of the expected size
+    void *map_existing(const std::string &path, size_t bytes) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return nullptr;
+        }
+        struct stat status = {};
+        void *mapping = nullptr;
+        if (fstat(fd, &status) == 0 && (size_t) status.st_size == bytes) {
+            mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        return mapping == MAP_FAILED ? nullptr : mapping;
+    }
+
+    // Builds into a temporary file that is only renamed to path once complete, so that an interrupted run leaves no
+    // truncated dataset behind
+    void *build_persisted(const std::string &path, size_t bytes, int64_t num_elements,
+                          const datasets::Generator &generator) {
+        const std::string temporary = path + ".tmp" + std::to_string(getpid());
+        int fd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            return nullptr;
+        }
+        void *mapping = MAP_FAILED;
+        if (ftruncate(fd, (off_t) bytes) == 0) {
+            mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            unlink(temporary.c_str());
+            return nullptr;
+        }
+        generator((int32_t *) mapping, num_elements);
+        if (rename(temporary.c_str(), path.c_str()) != 0) {
+            std::cerr << "Could not persist dataset " << path << ": " << strerror(errno) << std::endl;
+            unlink(temporary.c_str());
+        }
+        return mapping;
+    }
+
+    void *build_anonymous(size_t bytes, int64_t num_elements, const datasets::Generator &generator) {
+        void *mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            return nullptr;
+        }
+        generator((int32_t *) mapping, num_elements);
+        return mapping;
+    }
+}
+
+datasets::Dataset::Dataset(void *mapping, size_t mapping_bytes, int64_t num_elements, bool is_persisted)
+        : mapping(mapping), mapping_bytes(mapping_bytes), num_elements(num_elements), is_persisted(is_persisted) {
+}
+
+datasets::Dataset::~Dataset() {
+    munmap(mapping, mapping_bytes);
+}
+
+void datasets::Dataset::copy_to(int32_t *destination) const {
+    const tracing::Scope scope("dataset_copy", "setup");
+    data_generation::parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+        memcpy(&destination[begin], &data()[begin], sizeof(int32_t) * (end - begin));
+    });
+}
+
+std::shared_ptr<const datasets::Dataset> datasets::get(const std::string &name, int64_t num_elements,
+                                                       const Generator &generator) {
+    const std::string key = name + "_" + std::to_string(num_elements) + "_seed"
+                            + std::to_string(data_generation::seed()) + "_v"
+                            + std::to_string(DATASET_GENERATOR_VERSION);
+    const auto budget = (size_t) options::get_int("dataset_cache_mb", DATASET_CACHE_MEGABYTES) << 20;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = cache.find(key);
+    if (found != cache.end()) {
+        found->second.last_use = ++uses;
+        return found->second.dataset;
+    }
+
+    // The mapping is zero filled, which leaves the padding zero
+    const size_t bytes = sizeof(int32_t) * (num_elements + DATASET_PADDING);
+    const auto directory = options::get_string("dataset_dir", "");
+    void *mapping = nullptr;
+    bool is_persisted = false;
+    if (!directory.empty()) {
+        static bool warned = false;
+        if (!warned && !options::has("seed")) {
+            std::cerr << "Datasets are persisted under a random seed, pass --seed to reuse them" << std::endl;
+            warned = true;
+        }
+        const std::string path = directory + "/" + key + ".i32";
+        {
+            const tracing::Scope scope("dataset_map", "setup");
+            mapping = map_existing(path, bytes);
+        }
+        if (!mapping) {
+            const tracing::Scope scope("dataset_build", "setup");
+            mapping = build_persisted(path, bytes, num_elements, generator);
+            if (!mapping) {
+                std::cerr << "Could not create dataset " << path << ", it is kept in memory only" << std::endl;
+            }
+        }
+        is_persisted = mapping != nullptr;
+    }
+    if (!mapping) {
+        const tracing::Scope scope("dataset_build", "setup");
+        mapping = build_anonymous(bytes, num_elements, generator);
+        if (!mapping) {
+            throw std::bad_alloc();
+        }
+    }
+    mprotect(mapping, bytes, PROT_READ);
+
+    auto dataset = std::make_shared<const Dataset>(mapping, bytes, num_elements, is_persisted);
+    if (bytes <= budget) {
+        evict(budget - bytes);
+        cache[key] = {dataset, bytes, ++uses};
+        cached_bytes += bytes;
+    }
+    return dataset;
+}
+
+std::shared_ptr<const datasets::Dataset> datasets::values(int64_t num_elements) {
+    return get("values", num_elements, [](int32_t *array, int64_t num_elements) {
+        data_generation::fill_uniform(array, num_elements, data_generation::Random(data_generation::Stream::Values));
+    });
+}
+
+std::shared_ptr<const datasets::Dataset> datasets::indexes(access_patterns::Pattern pattern, int64_t num_elements,
+                                                           int64_t parameter) {
+    const std::string name = std::string("indexes_") + access_patterns::name(pattern) + "_" + std::to_string(parameter);
+    return get(name, num_elements, [&](int32_t *array, int64_t num_elements) {
+        access_patterns::generate(pattern, array, num_elements, parameter);
+    });
+}
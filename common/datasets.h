@@ -0,0 +1,79 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_DATASETS_H
+#define OPTIMIZATION_TESTING_GROUND_DATASETS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "../access_patterns/access_patterns.h"
+
+/*
+ * Generated arrays shared between benchmarks.
+ *
+ * Every instantiation and argument of e.g. BM_Prefetching used to generate its own 100M values and indexes, although
+ * the four variants of one pattern (with and without software prefetching, per cache state) read identical ones.
+ * Here an array is identified by its generator and the generator's parameters plus the seed, built the first time a
+ * benchmark asks for it and handed out read-only afterwards:
+ *   - kernels that only read an array (the indexes) use the shared one directly
+ *   - kernels that update one (the values) copy it into their own memory with copy_to(), a parallel memcpy instead of a
+ *     new generation for every benchmark
+ * Datasets are built into mappings that are made read-only once generated, a kernel writing to a shared one faults.
+ *
+ * The cache keeps the most recently used datasets up to --dataset_cache_mb, benchmarks hold on to the ones they use so
+ * an evicted dataset lives until its last user is done. --dataset_cache_mb=0 builds a dataset for every request.
+ *
+ * With --dataset_dir=path datasets are also persisted: each is built into a file in the directory, named after its key,
+ * and later runs with the same --seed map the file instead of generating it, which then costs little more than
+ * reading it from the page cache. Nothing checks a file against the code that would generate it now, so a change to
+ * access_patterns::generate, the data_generation fills or any other generator must bump DATASET_GENERATOR_VERSION,
+ * which leaves the files of earlier versions unused.
+ */
+#define DATASET_PADDING 8192 // Zero elements past the end of every dataset, room for the look-ahead of prefetches
+#define DATASET_CACHE_MEGABYTES 2048 // --dataset_cache_mb
+#define DATASET_GENERATOR_VERSION 1 // Part of every dataset's key, bump it whenever a generator changes its output
+
+namespace datasets {
+    class Dataset {
+    public:
+        Dataset(void *mapping, size_t mapping_bytes, int64_t num_elements, bool is_persisted);
+        ~Dataset();
+        Dataset(const Dataset &) = delete;
+        Dataset &operator=(const Dataset &) = delete;
+
+        // num_elements elements followed by DATASET_PADDING zeros
+        const int32_t *data() const {
+            return (const int32_t *) mapping;
+        }
+
+        int64_t size() const {
+            return num_elements;
+        }
+
+        bool persisted() const {
+            return is_persisted;
+        }
+
+        // Copies the num_elements elements, without the padding, to destination
+        void copy_to(int32_t *destination) const;
+
+    private:
+        void *mapping;
+        size_t mapping_bytes;
+        int64_t num_elements;
+        bool is_persisted;
+    };
+
+    // Fills num_elements elements of array, the same ones for the same name and seed
+    using Generator = std::function<void(int32_t *array, int64_t num_elements)>;
+
+    // The dataset built by generator, name must describe the generator and all of its parameters but the seed
+    std::shared_ptr<const Dataset> get(const std::string &name, int64_t num_elements, const Generator &generator);
+
+    // data_generation::fill_uniform on the Values stream
+    std::shared_ptr<const Dataset> values(int64_t num_elements);
+    // access_patterns::generate
+    std::shared_ptr<const Dataset> indexes(access_patterns::Pattern pattern, int64_t num_elements, int64_t parameter);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_DATASETS_H
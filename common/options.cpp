@@ -0,0 +1,103 @@
+#include "options.h"
+#include <iostream>
+#include <map>
+#include <sstream>
+
+static std::map<std::string, std::string> &values() {
+    static std::map<std::string, std::string> values;
+    return values;
+}
+
+static std::vector<std::string> split(const std::string &value) {
+    std::vector<std::string> parts;
+    std::stringstream stream(value);
+    std::string part;
+    while (std::getline(stream, part, ',')) {
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+void options::parse(int *argc, char **argv) {
+    int kept = 1;
+    for (int x = 1; x < *argc; x++) {
+        std::string arg = argv[x];
+        auto equals = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || equals == std::string::npos) {
+            argv[kept++] = argv[x];
+            continue;
+        }
+        values()[arg.substr(2, equals - 2)] = arg.substr(equals + 1);
+        if (arg.rfind("--benchmark_", 0) == 0) {
+            argv[kept++] = argv[x];
+        }
+    }
+    *argc = kept;
+}
+
+bool options::has(const std::string &name) {
+    return values().count(name) != 0;
+}
+
+std::string options::get_string(const std::string &name, const std::string &default_value) {
+    auto it = values().find(name);
+    return it == values().end() ? default_value : it->second;
+}
+
+int64_t options::get_int(const std::string &name, int64_t default_value) {
+    auto it = values().find(name);
+    if (it == values().end()) {
+        return default_value;
+    }
+    try {
+        return std::stoll(it->second);
+    } catch (const std::exception &) {
+        std::cerr << "Ignoring non integer value for --" << name << ": " << it->second << std::endl;
+        return default_value;
+    }
+}
+
+bool options::get_bool(const std::string &name, bool default_value) {
+    auto it = values().find(name);
+    if (it == values().end()) {
+        return default_value;
+    }
+    return it->second == "1" || it->second == "true" || it->second == "yes";
+}
+
+std::vector<std::string> options::get_string_list(const std::string &name,
+                                                  const std::vector<std::string> &default_value) {
+    auto it = values().find(name);
+    return it == values().end() ? default_value : split(it->second);
+}
+
+std::vector<int64_t> options::get_int_list(const std::string &name, const std::vector<int64_t> &default_value) {
+    auto it = values().find(name);
+    if (it == values().end()) {
+        return default_value;
+    }
+    std::vector<int64_t> parsed;
+    for (const auto &part : split(it->second)) {
+        try {
+            parsed.push_back(std::stoll(part));
+        } catch (const std::exception &) {
+            std::cerr << "Ignoring non integer entry for --" << name << ": " << part << std::endl;
+        }
+    }
+    return parsed;
+}
+
+std::vector<int64_t> options::get_int_list(const std::string &name, const std::vector<int64_t> &default_value,
+                                           int64_t minimum, int64_t maximum) {
+    std::vector<int64_t> in_range;
+    for (auto value : get_int_list(name, default_value)) {
+        if (value < minimum || value > maximum) {
+            std::cerr << "Ignoring out of range entry for --" << name << ": " << value << std::endl;
+            continue;
+        }
+        in_range.push_back(value);
+    }
+    return in_range;
+}
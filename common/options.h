@@ -0,0 +1,30 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_OPTIONS_H
+#define OPTIMIZATION_TESTING_GROUND_OPTIONS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Runtime options for the testing ground.
+ * Any argument of the form --name=value that is not a --benchmark_ flag is consumed here so that experiments which
+ * used to be selected with #define switches can be chosen per run instead of per build. --benchmark_ flags are left
+ * for benchmark::Initialize, but their values can be read here as well.
+ * Lists are comma separated, e.g. --prefetching_patterns=shuffled,random_walk
+ */
+namespace options {
+    // Strips our options out of argv, must be called before benchmark::Initialize
+    void parse(int *argc, char **argv);
+
+    bool has(const std::string &name);
+    std::string get_string(const std::string &name, const std::string &default_value);
+    int64_t get_int(const std::string &name, int64_t default_value);
+    bool get_bool(const std::string &name, bool default_value);
+    std::vector<std::string> get_string_list(const std::string &name, const std::vector<std::string> &default_value);
+    std::vector<int64_t> get_int_list(const std::string &name, const std::vector<int64_t> &default_value);
+    // Without the entries outside [minimum, maximum], for sizes and counts that a kernel cannot run with
+    std::vector<int64_t> get_int_list(const std::string &name, const std::vector<int64_t> &default_value,
+                                      int64_t minimum, int64_t maximum = INT64_MAX);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_OPTIONS_H
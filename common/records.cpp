@@ -0,0 +1,41 @@
+#include "records.h"
+
+const char *records::name(Layout layout) {
+    switch (layout) {
+        case Layout::AoS:
+            return "aos";
+        case Layout::SoA:
+            return "soa";
+    }
+    return "unknown";
+}
+
+bool records::from_name(const std::string &name, Layout *layout) {
+    for (auto candidate : {Layout::AoS, Layout::SoA}) {
+        if (name == records::name(candidate)) {
+            *layout = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *records::name(Alignment alignment) {
+    switch (alignment) {
+        case Alignment::Aligned:
+            return "aligned";
+        case Alignment::Straddling:
+            return "straddling";
+    }
+    return "unknown";
+}
+
+bool records::from_name(const std::string &name, Alignment *alignment) {
+    for (auto candidate : {Alignment::Aligned, Alignment::Straddling}) {
+        if (name == records::name(candidate)) {
+            *alignment = candidate;
+            return true;
+        }
+    }
+    return false;
+}
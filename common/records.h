@@ -0,0 +1,118 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_RECORDS_H
+#define OPTIMIZATION_TESTING_GROUND_RECORDS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+/*
+ * Fixed size records for the benchmark arrays, in place of int32_t elements or a boost uint512_t standing in for a
+ * cache line sized one.
+ *
+ * A record is a plain struct of int32_t fields, field 0 is the one the kernels update. A Table stores num_records of
+ * them in one of two layouts:
+ *   AoS: records one after the other, an access to any field pulls in the lines of the whole record
+ *   SoA: one column per field, field f of every record is contiguous
+ * and, for AoS, one of two alignments:
+ *   Aligned:    the array starts on a cache line, records of up to a line never straddle one
+ *   Straddling: the array starts half a record (at most half a line) past a line, so records cross line boundaries:
+ *               every 4th 16 B record, and every record of 64 B or more, which then spans one line more than it needs
+ * 4 B records cannot straddle a line with aligned int32_t fields, and SoA columns are always aligned.
+ */
+#define RECORD_LINE_SIZE 64
+
+namespace records {
+    template<size_t bytes>
+    struct Record {
+        static_assert(bytes >= sizeof(int32_t) && bytes % sizeof(int32_t) == 0, "Records are made of int32_t fields");
+        static constexpr size_t num_fields = bytes / sizeof(int32_t);
+        int32_t fields[num_fields];
+    };
+
+    enum class Layout {
+        AoS,
+        SoA,
+    };
+
+    enum class Alignment {
+        Aligned,
+        Straddling,
+    };
+
+    const char *name(Layout layout);
+    bool from_name(const std::string &name, Layout *layout);
+    const char *name(Alignment alignment);
+    bool from_name(const std::string &name, Alignment *alignment);
+
+    // Bytes the start of an AoS array is moved past a line boundary
+    constexpr size_t offset(size_t record_bytes, Alignment alignment) {
+        if (alignment == Alignment::Aligned || record_bytes <= sizeof(int32_t)) {
+            return 0;
+        }
+        return (record_bytes < RECORD_LINE_SIZE ? record_bytes : RECORD_LINE_SIZE) / 2;
+    }
+
+    template<size_t bytes, Layout layout>
+    class Table {
+    public:
+        using Type = Record<bytes>;
+        static constexpr size_t num_fields = Type::num_fields;
+
+        Table(int64_t num_records, Alignment alignment) : num_records(num_records) {
+            const size_t shift = layout == Layout::AoS ? offset(bytes, alignment) : 0;
+            memory = (char *) aligned_alloc(RECORD_LINE_SIZE, round_up(sizeof(Type) * num_records + shift));
+            base = (int32_t *) (memory + shift);
+        }
+
+        Table(const Table &) = delete;
+        Table &operator=(const Table &) = delete;
+
+        ~Table() {
+            free(memory);
+        }
+
+        inline int32_t &field(int64_t record, size_t field) {
+            if constexpr (layout == Layout::AoS) {
+                return base[record * num_fields + field];
+            } else {
+                return base[field * num_records + record];
+            }
+        }
+
+        // Prefetches the lines an access to the first `fields` fields of record touches
+        inline void prefetch(int64_t record, size_t fields) const {
+            if constexpr (layout == Layout::AoS) {
+                const char *first = (const char *) &base[record * num_fields];
+                const char *last = (const char *) &base[record * num_fields + fields - 1];
+                for (auto line = (uintptr_t) first & ~(uintptr_t) (RECORD_LINE_SIZE - 1);
+                     line <= (uintptr_t) last; line += RECORD_LINE_SIZE) {
+                    __builtin_prefetch((const void *) line);
+                }
+            } else {
+                for (size_t field = 0; field < fields; field++) {
+                    __builtin_prefetch(&base[field * num_records + record]);
+                }
+            }
+        }
+
+        const void *data() const {
+            return base;
+        }
+
+        size_t bytes_used() const {
+            return sizeof(Type) * num_records;
+        }
+
+    private:
+        static size_t round_up(size_t size) {
+            return (size + RECORD_LINE_SIZE - 1) / RECORD_LINE_SIZE * RECORD_LINE_SIZE;
+        }
+
+        int64_t num_records;
+        char *memory;
+        int32_t *base;
+    };
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_RECORDS_H
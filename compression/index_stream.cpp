@@ -0,0 +1,132 @@
+#include "index_stream.h"
+#include <algorithm>
+#include <immintrin.h>
+
+#define VALUES_PER_LANE (INDEX_STREAM_BLOCK_SIZE / INDEX_STREAM_LANES)
+
+static int bit_width(uint32_t value) {
+    return value ? 32 - __builtin_clz(value) : 0;
+}
+
+// Fills residuals for one slope and returns the reference that keeps them all non negative
+static int32_t residuals_for(const int32_t *block, int slope, uint32_t *residuals, int *width) {
+    int64_t reference = INT64_MAX;
+    for (int e = 0; e < INDEX_STREAM_BLOCK_SIZE; e++) {
+        reference = std::min(reference, (int64_t) block[e] - slope * e);
+    }
+    uint32_t combined = 0;
+    for (int e = 0; e < INDEX_STREAM_BLOCK_SIZE; e++) {
+        residuals[e] = (uint32_t) ((int64_t) block[e] - slope * e - reference);
+        combined |= residuals[e];
+    }
+    *width = bit_width(combined);
+    return (int32_t) reference;
+}
+
+index_stream::IndexStream index_stream::encode(const int32_t *index_array, int64_t num_elements) {
+    IndexStream stream;
+    stream.num_elements = num_elements;
+    int32_t block[INDEX_STREAM_BLOCK_SIZE];
+    uint32_t residuals[2][INDEX_STREAM_BLOCK_SIZE];
+
+    for (int64_t begin = 0; begin < num_elements; begin += INDEX_STREAM_BLOCK_SIZE) {
+        int64_t length = std::min((int64_t) INDEX_STREAM_BLOCK_SIZE, num_elements - begin);
+        std::copy(&index_array[begin], &index_array[begin + length], block);
+        std::fill(&block[length], &block[INDEX_STREAM_BLOCK_SIZE], *std::min_element(block, block + length));
+
+        int widths[2];
+        int32_t references[2];
+        for (int slope = 0; slope < 2; slope++) {
+            references[slope] = residuals_for(block, slope, residuals[slope], &widths[slope]);
+        }
+        int slope = widths[1] < widths[0];
+        BlockHeader header = {references[slope], (uint8_t) widths[slope], (uint8_t) slope,
+                              (uint32_t) stream.words.size()};
+        stream.headers.push_back(header);
+
+        // Lane l packs residuals l, l + 8, l + 16, ... into its own column of words
+        const int width = header.width;
+        const size_t first = stream.words.size();
+        stream.words.resize(first + (size_t) width * INDEX_STREAM_LANES, 0);
+        for (int lane = 0; lane < INDEX_STREAM_LANES && width; lane++) {
+            for (int j = 0; j < VALUES_PER_LANE; j++) {
+                uint64_t residual = residuals[slope][j * INDEX_STREAM_LANES + lane];
+                int bit = j * width;
+                uint32_t *word = &stream.words[first + (size_t) (bit / 32) * INDEX_STREAM_LANES + lane];
+                word[0] |= (uint32_t) (residual << (bit % 32));
+                if (bit % 32 + width > 32) {
+                    word[INDEX_STREAM_LANES] |= (uint32_t) (residual >> (32 - bit % 32));
+                }
+            }
+        }
+    }
+    return stream;
+}
+
+static void decode_block_scalar(const index_stream::BlockHeader &header, const uint32_t *words, int32_t *out) {
+    const int width = header.width;
+    const uint64_t mask = width == 32 ? 0xFFFFFFFFull : ((uint64_t) 1 << width) - 1;
+    for (int lane = 0; lane < INDEX_STREAM_LANES; lane++) {
+        for (int j = 0; j < VALUES_PER_LANE; j++) {
+            int bit = j * width;
+            uint64_t residual = 0;
+            if (width) {
+                const uint32_t *word = &words[(bit / 32) * INDEX_STREAM_LANES + lane];
+                residual = word[0] >> (bit % 32);
+                if (bit % 32 + width > 32) {
+                    residual |= (uint64_t) word[INDEX_STREAM_LANES] << (32 - bit % 32);
+                }
+            }
+            int e = j * INDEX_STREAM_LANES + lane;
+            out[e] = (int32_t) (header.reference + header.slope * e + (uint32_t) (residual & mask));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void decode_block_avx2(const index_stream::BlockHeader &header, const uint32_t *words, int32_t *out) {
+    const int width = header.width;
+    const __m256i mask = _mm256_set1_epi32(width == 32 ? -1 : (int) ((1u << width) - 1));
+    const __m256i step = _mm256_set1_epi32(header.slope * INDEX_STREAM_LANES);
+    __m256i base = _mm256_add_epi32(_mm256_set1_epi32(header.reference),
+                                    _mm256_mullo_epi32(_mm256_set1_epi32(header.slope),
+                                                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    if (width == 0) {
+        for (int j = 0; j < VALUES_PER_LANE; j++) {
+            _mm256_storeu_si256((__m256i *) &out[j * INDEX_STREAM_LANES], base);
+            base = _mm256_add_epi32(base, step);
+        }
+        return;
+    }
+
+    const auto *vectors = (const __m256i *) words;
+    __m256i current = _mm256_loadu_si256(vectors);
+    int word = 0;
+    int used = 0;
+    for (int j = 0; j < VALUES_PER_LANE; j++) {
+        __m256i residual = _mm256_srl_epi32(current, _mm_cvtsi32_si128(used));
+        used += width;
+        if (used >= 32) {
+            used -= 32;
+            if (++word < width) {
+                current = _mm256_loadu_si256(&vectors[word]);
+                // The high bits of a residual that straddles two words
+                residual = _mm256_or_si256(residual, _mm256_sll_epi32(current, _mm_cvtsi32_si128(width - used)));
+            }
+        }
+        residual = _mm256_and_si256(residual, mask);
+        _mm256_storeu_si256((__m256i *) &out[j * INDEX_STREAM_LANES], _mm256_add_epi32(base, residual));
+        base = _mm256_add_epi32(base, step);
+    }
+}
+
+void index_stream::decode_block(const IndexStream &stream, int64_t block, int32_t *out) {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    const BlockHeader &header = stream.headers[block];
+    const uint32_t *words = stream.words.data() + header.first_word;
+    if (has_avx2) {
+        decode_block_avx2(header, words, out);
+    } else {
+        decode_block_scalar(header, words, out);
+    }
+}
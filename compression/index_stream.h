@@ -0,0 +1,54 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_INDEX_STREAM_H
+#define OPTIMIZATION_TESTING_GROUND_INDEX_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * A compressed index array, decoded one block at a time right before the gather needs it.
+ *
+ * Format.
+ * Indexes are cut into blocks of INDEX_STREAM_BLOCK_SIZE. Each block stores its indexes as
+ *     index[e] = reference + slope * e + residual[e]
+ * with slope 0 (plain frame of reference, the block's minimum) or 1 (the delta of a sorted run), whichever needs
+ * fewer bits. The residuals are bit packed at the block's width in the SIMD-BP layout: element e goes to lane e % 8
+ * and each lane packs its 32 residuals into consecutive 32 bit words, so one 256 bit load holds the next word of
+ * all 8 lanes and 8 consecutive indexes come out of every shift and mask.
+ *
+ * A sequential block packs to 0 bits, a block of a bounded random offset p to about log2(2p) bits, a shuffled one
+ * stays at the full width of the array size, so the footprint follows how sorted the stream is.
+ * The tail block is padded with its reference, which keeps it as narrow as the rest of it.
+ */
+#define INDEX_STREAM_LANES 8
+#define INDEX_STREAM_BLOCK_SIZE (INDEX_STREAM_LANES * 32)
+
+namespace index_stream {
+    struct BlockHeader {
+        int32_t reference;
+        uint8_t width;
+        uint8_t slope;
+        uint32_t first_word;
+    };
+
+    struct IndexStream {
+        int64_t num_elements = 0;
+        std::vector<BlockHeader> headers;
+        std::vector<uint32_t> words;
+
+        int64_t num_blocks() const {
+            return (int64_t) headers.size();
+        }
+
+        size_t bytes() const {
+            return headers.size() * sizeof(BlockHeader) + words.size() * sizeof(uint32_t);
+        }
+    };
+
+    IndexStream encode(const int32_t *index_array, int64_t num_elements);
+
+    // Writes the INDEX_STREAM_BLOCK_SIZE indexes of one block to out, with AVX2 when the CPU has it
+    void decode_block(const IndexStream &stream, int64_t block, int32_t *out);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_INDEX_STREAM_H
@@ -0,0 +1,156 @@
+#include "perf_counters.h"
+#include <algorithm>
+#include <cpuid.h>
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "tracing.h"
+#include "../common/options.h"
+
+#define ENABLE_PERF_COUNTERS true // --perf_counters
+
+// Intel L1D_PEND_MISS.PENDING_CYCLES: event 0x48, umask 0x01, cmask 1
+#define INTEL_L1D_PENDING_MISS_CYCLES ((1ULL << 24) | (0x01 << 8) | 0x48)
+
+struct EventSpec {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    bool intel_only;
+};
+
+static uint64_t cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+static const std::vector<EventSpec> &event_specs() {
+    static const std::vector<EventSpec> specs = {
+            {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false},
+            {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, false},
+            {"LLC-load-misses", PERF_TYPE_HW_CACHE,
+             cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), false},
+            {"dTLB-load-misses", PERF_TYPE_HW_CACHE,
+             cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), false},
+            {"l1d-pending-miss-cycles", PERF_TYPE_RAW, INTEL_L1D_PENDING_MISS_CYCLES, true},
+    };
+    return specs;
+}
+
+static bool is_intel() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    char vendor[13];
+    memcpy(vendor, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+    vendor[12] = 0;
+    return strcmp(vendor, "GenuineIntel") == 0;
+}
+
+static int open_event(const EventSpec &spec, int group_fd, bool inherit) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    attr.disabled = group_fd == -1;
+    attr.inherit = inherit;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void warn_once(const std::string &message) {
+    static bool warned = false;
+    if (!warned) {
+        std::cerr << message << std::endl;
+        warned = true;
+    }
+}
+
+perf_counters::PerfCounters::PerfCounters(bool inherit) {
+    if (!options::get_bool("perf_counters", ENABLE_PERF_COUNTERS)) {
+        return;
+    }
+    const bool intel = is_intel();
+    std::vector<std::string> unavailable;
+    for (const auto &spec : event_specs()) {
+        if (spec.intel_only && !intel) {
+            unavailable.emplace_back(spec.name);
+            continue;
+        }
+        int fd = inherit || leader == -1 ? -1 : open_event(spec, leader, inherit);
+        if (fd == -1) {
+            // First event, inherited counting or the group is full, count this event on its own
+            fd = open_event(spec, -1, inherit);
+            if (fd == -1) {
+                unavailable.emplace_back(spec.name);
+                continue;
+            }
+            if (leader == -1 && !inherit) {
+                leader = fd;
+            } else {
+                standalone.push_back(fd);
+            }
+        }
+        events.push_back({spec.name, fd});
+    }
+    if (!unavailable.empty()) {
+        std::string message = "perf_event_open could not count:";
+        for (const auto &name : unavailable) {
+            message += " " + name;
+        }
+        warn_once(message + " (check /proc/sys/kernel/perf_event_paranoid), these counters are left out");
+    }
+}
+
+perf_counters::PerfCounters::~PerfCounters() {
+    for (const auto &event : events) {
+        close(event.fd);
+    }
+}
+
+void perf_counters::PerfCounters::start() {
+    if (leader != -1) {
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    for (int fd : standalone) {
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    pass_begin = tracing::begin("measure");
+}
+
+void perf_counters::PerfCounters::stop() {
+    tracing::end("measure", "measurement", pass_begin, "pass", passes++);
+    if (leader != -1) {
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+    for (int fd : standalone) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+void perf_counters::PerfCounters::report(benchmark::State &state) {
+    tracing::end_run(state);
+    if (events.empty()) {
+        return;
+    }
+    double running_fraction = 1;
+    for (const auto &event : events) {
+        uint64_t values[3]; // value, time enabled, time running
+        if (read(event.fd, values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+            continue;
+        }
+        double fraction = (double) values[2] / (double) values[1];
+        running_fraction = std::min(running_fraction, fraction);
+        state.counters[event.name] = benchmark::Counter((double) values[0] / fraction,
+                                                        benchmark::Counter::kAvgIterations);
+    }
+    state.counters["perf_running_fraction"] = running_fraction;
+}
@@ -0,0 +1,59 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_PERF_COUNTERS_H
+#define OPTIMIZATION_TESTING_GROUND_PERF_COUNTERS_H
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Hardware counters read with perf_event_open and attached to a benchmark's state.counters.
+ *
+ * The hypotheses in this repo are about branch mispredictions (clusteredness) and LLC / dTLB misses (prefetching) so
+ * those are measured directly instead of inferred from run time. Events are opened as one group so they are scheduled
+ * together, any event that does not fit into the group is opened on its own. When the PMU has to multiplex, values are
+ * scaled by time_enabled / time_running and perf_running_fraction reports the worst fraction an event was counted for.
+ *
+ * Events that cannot be opened (no PMU in a VM, perf_event_paranoid in a container, a vendor specific raw event on
+ * another vendor) are left out of the results with a single warning, the benchmark itself still runs.
+ *
+ * Usage:
+ *     perf_counters::PerfCounters counters;
+ *     for (auto _ : state) {
+ *         counters.start();
+ *         ... measured work ...
+ *         counters.stop();
+ *     }
+ *     counters.report(state);
+ * Every start() to stop() pass is also a measurement span of the phase trace, see instrumentation/tracing.h.
+ */
+namespace perf_counters {
+    class PerfCounters {
+    public:
+        // inherit also counts threads created after construction, the kernel does not allow that for groups so every
+        // event is then opened on its own
+        explicit PerfCounters(bool inherit = false);
+        ~PerfCounters();
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        void start();
+        void stop();
+        // Adds one counter per available event, averaged per iteration
+        void report(benchmark::State &state);
+
+    private:
+        struct Event {
+            std::string name;
+            int fd;
+        };
+
+        std::vector<Event> events;
+        int leader = -1;
+        std::vector<int> standalone;
+        uint64_t pass_begin = 0;
+        int64_t passes = 0;
+    };
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_PERF_COUNTERS_H
@@ -0,0 +1,222 @@
+#include "tracing.h"
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "ittnotify.h"
+#include "../common/options.h"
+
+#define ADD_VTUNE_INSTRUMENTATION false // --vtune_instrumentation
+
+bool tracing::is_recording = false;
+bool tracing::is_itt_enabled = false;
+
+namespace {
+    struct Buffer {
+        int id;
+        std::vector<tracing::Event> events;
+        uint64_t written = 0;
+    };
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    std::vector<Buffer *> free_buffers;
+    // Benchmark names outlive the reports, events point into them
+    std::deque<std::string> names;
+
+    // Returns the thread's buffer to the free list when the thread exits
+    struct Lease {
+        Buffer *buffer = nullptr;
+
+        ~Lease() {
+            if (buffer) {
+                std::lock_guard<std::mutex> lock(mutex);
+                free_buffers.push_back(buffer);
+            }
+        }
+    };
+
+    thread_local Lease lease;
+
+    uint64_t start_tsc;
+    std::chrono::steady_clock::time_point start_time;
+    // End of the previous run and benchmark span
+    uint64_t run_boundary;
+    uint64_t benchmark_boundary;
+
+    __itt_domain *domain;
+
+    Buffer *acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!free_buffers.empty()) {
+            lease.buffer = free_buffers.back();
+            free_buffers.pop_back();
+        } else {
+            buffers.push_back(std::make_unique<Buffer>());
+            buffers.back()->id = (int) buffers.size() - 1;
+            buffers.back()->events.resize(TRACE_BUFFER_EVENTS);
+            lease.buffer = buffers.back().get();
+        }
+        return lease.buffer;
+    }
+
+    void write_string(std::ostream &out, const char *string) {
+        out << '"';
+        for (const char *c = string; *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                out << '\\';
+            }
+            out << *c;
+        }
+        out << '"';
+    }
+}
+
+void tracing::start() {
+    is_recording = !options::get_string("trace", "").empty();
+    is_itt_enabled = options::get_bool("vtune_instrumentation", ADD_VTUNE_INSTRUMENTATION);
+    if (is_itt_enabled) {
+        domain = __itt_domain_create("Optimization Testing Ground");
+    }
+    start_time = std::chrono::steady_clock::now();
+    start_tsc = __rdtsc();
+    run_boundary = start_tsc;
+    benchmark_boundary = start_tsc;
+    if (is_recording) {
+        // The main thread takes the first lane
+        acquire();
+    }
+}
+
+void tracing::record(const Event &event) {
+    Buffer *buffer = lease.buffer ? lease.buffer : acquire();
+    buffer->events[buffer->written++ % TRACE_BUFFER_EVENTS] = event;
+}
+
+void tracing::itt_begin(const char *name) {
+    __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create(name));
+}
+
+void tracing::itt_end() {
+    __itt_task_end(domain);
+}
+
+void tracing::end_run(const benchmark::State &state) {
+    if (!is_recording) {
+        return;
+    }
+    const uint64_t now = __rdtsc();
+    record({"run", "run", run_boundary, now, "iterations", (int64_t) state.iterations()});
+    run_boundary = now;
+}
+
+// The display reporter benchmark::RunSpecifiedBenchmarks would create itself from the same flags
+static std::unique_ptr<benchmark::BenchmarkReporter> display_reporter() {
+    const auto format = options::get_string("benchmark_format", "console");
+    if (format == "json") {
+        return std::make_unique<benchmark::JSONReporter>();
+    }
+    if (format == "csv") {
+        // Deprecated but still what --benchmark_format=csv selects
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+        return std::make_unique<benchmark::CSVReporter>();
+#pragma GCC diagnostic pop
+    }
+    if (format != "console") {
+        std::cerr << "Unknown --benchmark_format: " << format << ", using console" << std::endl;
+    }
+    const auto color = options::get_string("benchmark_color", "auto");
+    const bool is_colored = color == "auto" ? isatty(STDOUT_FILENO) : options::get_bool("benchmark_color", true);
+    const bool is_tabular = options::get_bool("benchmark_counters_tabular", false);
+    return std::make_unique<benchmark::ConsoleReporter>(
+            (benchmark::ConsoleReporter::OutputOptions) ((is_colored ? benchmark::ConsoleReporter::OO_Color : 0)
+                                                        | (is_tabular ? benchmark::ConsoleReporter::OO_Tabular : 0)));
+}
+
+tracing::Reporter::Reporter() : display(display_reporter()) {
+}
+
+bool tracing::Reporter::ReportContext(const Context &context) {
+    return display->ReportContext(context);
+}
+
+void tracing::Reporter::Finalize() {
+    display->Finalize();
+}
+
+void tracing::Reporter::ReportRuns(const std::vector<Run> &reports) {
+    int64_t repetitions = 0;
+    for (const auto &run : reports) {
+        repetitions += run.run_type == Run::RT_Iteration;
+    }
+    // The aggregates of repeated benchmarks (mean, median, ..) are reported on their own afterwards
+    if (is_recording && repetitions) {
+        const uint64_t now = __rdtsc();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            names.push_back(reports.front().run_name.str());
+        }
+        record({names.back().c_str(), "benchmark", benchmark_boundary, now, "repetitions", repetitions});
+        benchmark_boundary = now;
+        run_boundary = now;
+    }
+    display->ReportRuns(reports);
+}
+
+void tracing::write() {
+    if (!is_recording) {
+        return;
+    }
+    const double ns_per_tick = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_time).count() / (double) (__rdtsc() - start_tsc);
+    const auto microseconds = [&](uint64_t ticks) {
+        return (double) ticks * ns_per_tick / 1e3;
+    };
+
+    const auto path = options::get_string("trace", "");
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Could not write the trace to " << path << std::endl;
+        return;
+    }
+    out.precision(15);
+    const int pid = getpid();
+    uint64_t dropped = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto &buffer : buffers) {
+        out << (first ? "" : ",\n") << R"({"name":"thread_name","ph":"M","pid":)" << pid << ",\"tid\":" << buffer->id
+            << R"(,"args":{"name":)" << (buffer->id ? "\"worker " + std::to_string(buffer->id) + "\"" : "\"main\"")
+            << "}}";
+        first = false;
+
+        // Oldest event first, which is past the write position once the ring has wrapped
+        const uint64_t count = std::min<uint64_t>(buffer->written, TRACE_BUFFER_EVENTS);
+        dropped += buffer->written - count;
+        for (uint64_t i = buffer->written - count; i < buffer->written; i++) {
+            const auto &event = buffer->events[i % TRACE_BUFFER_EVENTS];
+            out << ",\n{\"name\":";
+            write_string(out, event.name);
+            out << ",\"cat\":\"" << event.category << R"(","ph":"X","pid":)" << pid << ",\"tid\":" << buffer->id
+                << ",\"ts\":" << microseconds(event.begin - start_tsc) << ",\"dur\":"
+                << microseconds(event.end - event.begin);
+            if (event.value_name) {
+                out << ",\"args\":{\"" << event.value_name << "\":" << event.value << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    std::cerr << "Trace written to " << path;
+    if (dropped) {
+        std::cerr << ", " << dropped << " of the oldest events were overwritten, raise TRACE_BUFFER_EVENTS to keep them";
+    }
+    std::cerr << std::endl;
+}
@@ -0,0 +1,120 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_TRACING_H
+#define OPTIMIZATION_TESTING_GROUND_TRACING_H
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <x86intrin.h>
+
+/*
+ * Phase tracing of the whole run, written as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+ *
+ * Google Benchmark only reports the timed loop, yet setup (generating 100M values), cache preconditioning and the
+ * PauseTiming / ResumeTiming around it often take most of the wall time. With --trace=path every phase is recorded as
+ * a span: begin and end are read with rdtsc and the event is stored into a ring buffer owned by the thread, so a span
+ * costs two rdtsc and a store and nothing is shared between threads. Without --trace (or --vtune_instrumentation) a
+ * span is a single predictable branch.
+ *
+ * Spans recorded by the shared code, so every suite is covered:
+ *   setup:        the data_generation fills, one span per generation thread, and access_patterns::generate
+ *   precondition: cache::Precondition::apply, named after the cache state
+ *   measurement:  every counters.start() to counters.stop() pass, numbered within its run
+ *   run:          one invocation of a benchmark function (a repetition, or a run sizing the iteration count), from
+ *                 the end of the previous run to its counters.report(state)
+ *   benchmark:    every run of one benchmark, named after it, spans end when the benchmark is reported
+ * Gaps between the spans of one run are the framework's own time, e.g. ResumeTiming between a precondition and a pass.
+ *
+ * Timestamps are converted to nanoseconds by timing the TSC against steady_clock between start() and write(), which
+ * assumes an invariant TSC (any x86 CPU of the last decade). Each buffer holds TRACE_BUFFER_EVENTS events and
+ * overwrites its oldest ones once full, write() says how many were lost. Buffers are handed back when their thread
+ * exits and reused by the next one, so the generation threads of successive fills share a few lanes of the trace.
+ *
+ * ITT is a second sink: with --vtune_instrumentation every span is also an ITT task, to line the phases up with a
+ * VTune collection.
+ */
+#define TRACE_BUFFER_EVENTS 65536
+
+namespace tracing {
+    struct Event {
+        const char *name;
+        const char *category;
+        uint64_t begin;
+        uint64_t end;
+        const char *value_name; // An argument of the event, nullptr when there is none
+        int64_t value;
+    };
+
+    extern bool is_recording; // --trace
+    extern bool is_itt_enabled; // --vtune_instrumentation
+
+    // Reads the options and starts the clock, call once after options::parse
+    void start();
+    // Writes the trace to the --trace path
+    void write();
+
+    void record(const Event &event);
+    void itt_begin(const char *name);
+    void itt_end();
+
+    // Returns the timestamp to pass to end(), 0 when tracing is off
+    inline uint64_t begin(const char *name) {
+        if (!is_recording && !is_itt_enabled) {
+            return 0;
+        }
+        if (is_itt_enabled) {
+            itt_begin(name);
+        }
+        return __rdtsc();
+    }
+
+    inline void end(const char *name, const char *category, uint64_t begin, const char *value_name = nullptr,
+                    int64_t value = 0) {
+        if (!begin) {
+            return;
+        }
+        const uint64_t end = __rdtsc();
+        if (is_itt_enabled) {
+            itt_end();
+        }
+        if (is_recording) {
+            record({name, category, begin, end, value_name, value});
+        }
+    }
+
+    // A span covering the lifetime of the scope, name and category must be string literals
+    class Scope {
+    public:
+        Scope(const char *name, const char *category) : name(name), category(category), start(begin(name)) {
+        }
+
+        ~Scope() {
+            end(name, category, start);
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        const char *name;
+        const char *category;
+        uint64_t start;
+    };
+
+    // Ends the run span of the benchmark function invocation that state belongs to
+    void end_run(const benchmark::State &state);
+
+    // Forwards to the reporter --benchmark_format asks for, ending a benchmark span for every benchmark it reports
+    class Reporter : public benchmark::BenchmarkReporter {
+    public:
+        Reporter();
+        bool ReportContext(const Context &context) override;
+        void ReportRuns(const std::vector<Run> &reports) override;
+        void Finalize() override;
+
+    private:
+        std::unique_ptr<benchmark::BenchmarkReporter> display;
+    };
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_TRACING_H
@@ -0,0 +1,204 @@
+#include "interleaved_gather.h"
+#include <cstring>
+#include <iostream>
+#include "interleaving.h"
+#include "../access_patterns/access_patterns.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/options.h"
+#include "../instrumentation/perf_counters.h"
+
+// Tunable parameters
+#define PREFETCH_OFFSET 64 // Same look-ahead as BM_Prefetching in prefetching.cpp
+#define NUM_ELEMENTS_IN_EXPERIMENTS 100000000 // --interleaved_elements
+#define REPETITIONS_OF_EXPERIMENTS 10 // --interleaved_iterations
+
+/*
+ * The indirect update of BM_Prefetching, array[index_array[x]]++, extended to lookups of several hops:
+ *     index = index_array[x];
+ *     for (hop = 1; hop < hops; hop++) index = links[index];
+ *     array[index]++;
+ * links is a random permutation, so every hop is a dependent miss. One hop is exactly the BM_Prefetching kernel.
+ *
+ * Engines.
+ *   NoPrefetch:     the loop above
+ *   FixedLookahead: additionally prefetches the first hop of lookup x + PREFETCH_OFFSET, as BM_Prefetching does, the
+ *                   later hops cannot be prefetched as their addresses are still in memory
+ *   StateMachine:   group_size lookups interleaved by interleaving::run_state_machine, every hop is prefetched
+ *   Coroutine:      the same through C++20 coroutines and interleaving::run_coroutines
+ *
+ * Hypothesis.
+ * At one hop the interleaved engines should match the fixed look-ahead once the group holds as many misses as the
+ * core can keep in flight (about the number of line fill buffers). With more hops the fixed look-ahead falls back
+ * towards no prefetching while the interleaved engines keep a group worth of misses in flight at every hop.
+ * The coroutine engine pays for a resume per hop and a frame per lookup on top of the state machine.
+ */
+enum class Engine {
+    NoPrefetch,
+    FixedLookahead,
+    StateMachine,
+    Coroutine,
+};
+
+struct GatherLookup {
+    int32_t *array;
+    const int32_t *links;
+    const int32_t *index_array;
+    int hops;
+
+    struct State {
+        int32_t index;
+        int remaining_hops;
+    };
+
+    inline const void *target(const State &state) const {
+        return state.remaining_hops ? (const void *) &links[state.index] : (const void *) &array[state.index];
+    }
+
+    inline void start(State &state, int64_t lookup) const {
+        state.index = index_array[lookup];
+        state.remaining_hops = hops - 1;
+        __builtin_prefetch(target(state));
+    }
+
+    inline bool step(State &state) const {
+        if (state.remaining_hops) {
+            state.index = links[state.index];
+            state.remaining_hops--;
+            __builtin_prefetch(target(state));
+            return false;
+        }
+        benchmark::DoNotOptimize(array[state.index]++);
+        return true;
+    }
+};
+
+static interleaving::Task gather(int32_t *array, const int32_t *links, int32_t index, int hops) {
+    for (int hop = 1; hop < hops; hop++) {
+        co_await interleaving::prefetch{&links[index]};
+        index = links[index];
+    }
+    co_await interleaving::prefetch{&array[index]};
+    benchmark::DoNotOptimize(array[index]++);
+}
+
+static constexpr bool is_grouped(Engine engine) {
+    return engine == Engine::StateMachine || engine == Engine::Coroutine;
+}
+
+template<Engine engine>
+static void BM_Interleaved_Gather(benchmark::State &state, access_patterns::Pattern pattern) {
+    // Setup
+    const auto num_elements = state.range(0);
+    const auto hops = (int) state.range(1);
+    const auto group_size = is_grouped(engine) ? (int) state.range(2) : 0;
+    const auto parameter = access_patterns::has_parameter(pattern) ? state.range(is_grouped(engine) ? 3 : 2) : 0;
+
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    auto *links = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    // The look-ahead prefetches read up to 2 * PREFETCH_OFFSET elements past the end so the tail is padded with zeros
+    auto *index_array = (int32_t *) malloc(sizeof(int32_t) * (num_elements + 2 * PREFETCH_OFFSET));
+    memset(&index_array[num_elements], 0, sizeof(int32_t) * 2 * PREFETCH_OFFSET);
+    datasets::values(num_elements)->copy_to(array);
+    data_generation::fill_permutation(links, num_elements, data_generation::Random(data_generation::Stream::Links));
+    datasets::indexes(pattern, num_elements, parameter)->copy_to(index_array);
+
+    GatherLookup lookup = {array, links, index_array, hops};
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        if constexpr (engine == Engine::NoPrefetch || engine == Engine::FixedLookahead) {
+            for (int64_t x = 0; x < num_elements; x++) {
+                if constexpr (engine == Engine::FixedLookahead) {
+                    GatherLookup::State ahead = {index_array[x + PREFETCH_OFFSET], hops - 1};
+                    __builtin_prefetch(lookup.target(ahead));
+                    __builtin_prefetch(&index_array[x + 2 * PREFETCH_OFFSET]);
+                }
+                int32_t index = index_array[x];
+                for (int hop = 1; hop < hops; hop++) {
+                    index = links[index];
+                }
+                benchmark::DoNotOptimize(array[index]++);
+            }
+        } else if constexpr (engine == Engine::StateMachine) {
+            interleaving::run_state_machine(lookup, num_elements, group_size);
+        } else {
+            interleaving::run_coroutines([&](int64_t x) {
+                return gather(array, links, index_array[x], hops);
+            }, num_elements, group_size);
+        }
+        counters.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    state.SetItemsProcessed(num_elements * state.iterations());
+
+    // Teardown
+    free(index_array);
+    free(links);
+    free(array);
+}
+
+template<Engine engine>
+static void register_engine(const char *engine_name, access_patterns::Pattern pattern, int64_t num_elements,
+                            int64_t iterations, const std::vector<int64_t> &hop_counts,
+                            const std::vector<int64_t> &grouped_sizes) {
+    if (hop_counts.empty() || (is_grouped(engine) && grouped_sizes.empty())) {
+        return;
+    }
+    std::string name = std::string("BM_Interleaved_Gather<") + access_patterns::name(pattern) + ", " + engine_name
+                       + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Interleaved_Gather<engine>, pattern);
+
+    std::vector<std::string> arg_names = {"elements", "hops"};
+    std::vector<int64_t> group_sizes = {0};
+    if constexpr (is_grouped(engine)) {
+        arg_names.emplace_back("group_size");
+        group_sizes = grouped_sizes;
+    }
+    std::vector<int64_t> parameters = {0};
+    if (access_patterns::has_parameter(pattern)) {
+        arg_names.emplace_back(access_patterns::parameter_name(pattern));
+        parameters = access_patterns::grid(pattern);
+    }
+    b->ArgNames(arg_names);
+
+    for (auto hops : hop_counts) {
+        for (auto group_size : group_sizes) {
+            for (auto parameter : parameters) {
+                std::vector<int64_t> args = {num_elements, hops};
+                if constexpr (is_grouped(engine)) {
+                    args.push_back(group_size);
+                }
+                if (access_patterns::has_parameter(pattern)) {
+                    args.push_back(parameter);
+                }
+                b->Args(args);
+            }
+        }
+    }
+    b->Iterations(iterations);
+}
+
+void interleaved_gather::register_benchmarks() {
+    const auto num_elements = options::get_int("interleaved_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto iterations = options::get_int("interleaved_iterations", REPETITIONS_OF_EXPERIMENTS);
+    // A lookup without hops or an empty group would never complete
+    const auto hop_counts = options::get_int_list("interleaved_hops", {1, 2, 4}, 1);
+    const auto group_sizes = options::get_int_list("interleaved_group_sizes", {1, 2, 4, 8, 16, 32, 64}, 1);
+    for (const auto &pattern_name : options::get_string_list("interleaved_patterns", {"shuffled"})) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        register_engine<Engine::NoPrefetch>("no_prefetch", pattern, num_elements, iterations, hop_counts, group_sizes);
+        register_engine<Engine::FixedLookahead>("fixed_lookahead", pattern, num_elements, iterations, hop_counts,
+                                                group_sizes);
+        register_engine<Engine::StateMachine>("state_machine", pattern, num_elements, iterations, hop_counts,
+                                              group_sizes);
+        register_engine<Engine::Coroutine>("coroutine", pattern, num_elements, iterations, hop_counts, group_sizes);
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_INTERLEAVED_GATHER_H
+#define OPTIMIZATION_TESTING_GROUND_INTERLEAVED_GATHER_H
+
+#include <benchmark/benchmark.h>
+
+namespace interleaved_gather {
+    void register_benchmarks();
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_INTERLEAVED_GATHER_H
@@ -0,0 +1,51 @@
+#include "interleaving.h"
+#include <new>
+
+#define FRAME_BLOCK_SIZE 256 // Frames up to this size are recycled, larger ones go to the heap
+
+/*
+ * One coroutine frame is created per lookup, so going to malloc for each of them would cost more than the lookup.
+ * Frames of at most FRAME_BLOCK_SIZE bytes are kept on a per thread free list instead, which after the first group
+ * never grows, as a frame is always freed before the next lookup is started in its slot.
+ */
+namespace {
+    struct FreeFrame {
+        FreeFrame *next;
+    };
+
+    struct FramePool {
+        FreeFrame *free = nullptr;
+
+        ~FramePool() {
+            while (free) {
+                FreeFrame *next = free->next;
+                ::operator delete(free);
+                free = next;
+            }
+        }
+    };
+
+    thread_local FramePool pool;
+}
+
+void *interleaving::Task::promise_type::operator new(size_t bytes) {
+    if (bytes > FRAME_BLOCK_SIZE) {
+        return ::operator new(bytes);
+    }
+    if (!pool.free) {
+        return ::operator new(FRAME_BLOCK_SIZE);
+    }
+    FreeFrame *frame = pool.free;
+    pool.free = frame->next;
+    return frame;
+}
+
+void interleaving::Task::promise_type::operator delete(void *frame, size_t bytes) {
+    if (bytes > FRAME_BLOCK_SIZE) {
+        ::operator delete(frame);
+        return;
+    }
+    auto *free_frame = (FreeFrame *) frame;
+    free_frame->next = pool.free;
+    pool.free = free_frame;
+}
@@ -0,0 +1,144 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_INTERLEAVING_H
+#define OPTIMIZATION_TESTING_GROUND_INTERLEAVING_H
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+/*
+ * Interleaved execution of independent lookups (asynchronous memory access chaining, AMAC).
+ *
+ * A fixed look-ahead prefetch, __builtin_prefetch(&array[index_array[x + PREFETCH_OFFSET]]), only works when the
+ * address of a future access can be computed without waiting on memory. A lookup that chases several pointers cannot be
+ * prefetched ahead like that, as each address is only known once the previous load has returned.
+ *
+ * Instead up to group_size lookups are in flight at once. Each lookup prefetches the line it needs next and gives
+ * control back, a round robin scheduler then moves on to the other lookups of the group and only comes back to it once
+ * the rest of the group has had a turn, by which time the line has likely arrived. A finished lookup is replaced by the
+ * next one straight away, so the group stays full until the input runs out.
+ *
+ * Two implementations of the same idea:
+ *   run_state_machine: the lookup is a hand rolled state machine, a Lookup type with
+ *                          struct State;                          // everything a lookup needs between steps
+ *                          void start(State &, int64_t lookup);    // begin lookup number `lookup`, prefetch
+ *                          bool step(State &);                     // use the prefetched line, prefetch the next one,
+ *                                                                  // true once the lookup has completed
+ *   run_coroutines:    the lookup is a C++20 coroutine returning Task, which co_awaits prefetch(address) wherever it
+ *                      would otherwise stall. Frames come from a per thread free list rather than the heap.
+ */
+namespace interleaving {
+    template<typename Lookup>
+    void run_state_machine(Lookup &lookup, int64_t num_lookups, int group_size) {
+        assert(group_size >= 1);
+        std::vector<typename Lookup::State> group(group_size);
+        int64_t next = 0;
+        int active = 0;
+        for (; active < group_size && next < num_lookups; active++) {
+            lookup.start(group[active], next++);
+        }
+
+        // Steady state, every slot is live and is refilled as soon as its lookup completes
+        while (next < num_lookups) {
+            for (int slot = 0; slot < active && next < num_lookups; slot++) {
+                if (lookup.step(group[slot])) {
+                    lookup.start(group[slot], next++);
+                }
+            }
+        }
+
+        // Drain, a completed slot is swapped with the last live one
+        while (active) {
+            for (int slot = 0; slot < active;) {
+                if (lookup.step(group[slot])) {
+                    group[slot] = group[--active];
+                } else {
+                    slot++;
+                }
+            }
+        }
+    }
+
+    class Task {
+    public:
+        struct promise_type {
+            Task get_return_object() {
+                return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            // Runs up to its first prefetch when created
+            std::suspend_never initial_suspend() noexcept {
+                return {};
+            }
+
+            // Kept alive so the scheduler can see done() before destroying it
+            std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+
+            void return_void() {}
+
+            void unhandled_exception() {
+                std::terminate();
+            }
+
+            static void *operator new(size_t bytes);
+            static void operator delete(void *frame, size_t bytes);
+        };
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    // co_await prefetch(address) issues the prefetch and suspends until the scheduler comes back round
+    struct prefetch {
+        const void *address;
+
+        bool await_ready() const noexcept {
+            __builtin_prefetch(address);
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+        void await_resume() const noexcept {}
+    };
+
+    // start(lookup) creates the coroutine for lookup number `lookup`
+    template<typename Start>
+    void run_coroutines(Start &&start, int64_t num_lookups, int group_size) {
+        assert(group_size >= 1);
+        std::vector<std::coroutine_handle<Task::promise_type>> group;
+        group.reserve(group_size);
+        int64_t next = 0;
+        for (; (int) group.size() < group_size && next < num_lookups; next++) {
+            group.push_back(start(next).handle);
+        }
+
+        while (!group.empty()) {
+            for (size_t slot = 0; slot < group.size();) {
+                auto &handle = group[slot];
+                if (!handle.done()) {
+                    handle.resume();
+                }
+                if (!handle.done()) {
+                    slot++;
+                    continue;
+                }
+                handle.destroy();
+                if (next < num_lookups) {
+                    handle = start(next++).handle;
+                    slot++;
+                } else {
+                    handle = group.back();
+                    group.pop_back();
+                }
+            }
+        }
+    }
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_INTERLEAVING_H
@@ -0,0 +1,226 @@
+#include "record_layouts.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "../access_patterns/access_patterns.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/options.h"
+#include "../common/records.h"
+#include "../instrumentation/perf_counters.h"
+
+// Tunable parameters
+#define PREFETCH_OFFSET 64 // Same look-ahead as BM_Prefetching in prefetching.cpp
+#define NUM_ELEMENTS_IN_EXPERIMENTS 2097152 // --record_elements, records per table whatever their size
+#define REPETITIONS_OF_EXPERIMENTS 10 // --record_iterations
+
+/*
+ * The indirect update of BM_Prefetching over a table of records (see common/records.h) rather than an int32_t array.
+ *   HotField:    table[index_array[x]].fields[0]++, the one column a scan or aggregation reads
+ *   WholeRecord: every field of the record is read and their sum added to field 0, a row being materialised
+ * With software prefetching every line the access is about to touch is prefetched PREFETCH_OFFSET accesses ahead:
+ * one line, or every line the record spans (AoS), or one line per column (SoA).
+ *
+ * The tables hold the same number of records at every size, like the same table stored with a narrower or wider row,
+ * so the footprint grows with the record.
+ *
+ * Hypothesis.
+ *   Sequential: AoS gets RECORD_LINE_SIZE / record bytes records out of every line. Past a line per record each access
+ *               is a new line, the hardware prefetcher has to cover the whole record and the HotField access wastes
+ *               the rest of the line, where SoA keeps the hot column dense.
+ *   Shuffled:   every access is a miss whatever the size, so the time per access should stay flat until a record
+ *               spans several lines, which the adjacent line prefetcher only partly covers. Software prefetching has
+ *               to issue one prefetch per line of the record and gains less per prefetch as records grow.
+ *   Straddling: a 64 B record spans two lines instead of one, the cost of a misaligned row format.
+ *
+ * Counters.
+ *   record_bytes:     size of one record
+ *   lines_per_access: lines of the table an access of this kind touches, averaged over the records
+ */
+enum class Access {
+    HotField,
+    WholeRecord,
+};
+
+template<size_t bytes, records::Layout layout>
+static double lines_per_access(records::Table<bytes, layout> &table, int64_t num_records, size_t fields) {
+    const int64_t sample = std::min(num_records, (int64_t) RECORD_LINE_SIZE);
+    int64_t lines = 0;
+    for (int64_t record = 0; record < sample; record++) {
+        if constexpr (layout == records::Layout::AoS) {
+            auto first = (uintptr_t) &table.field(record, 0) / RECORD_LINE_SIZE;
+            auto last = (uintptr_t) &table.field(record, fields - 1) / RECORD_LINE_SIZE;
+            lines += (int64_t) (last - first + 1);
+        } else {
+            lines += (int64_t) fields;
+        }
+    }
+    return (double) lines / (double) sample;
+}
+
+template<size_t bytes, records::Layout layout, Access access, bool is_software_prefetching_used>
+static void BM_Records(benchmark::State &state, access_patterns::Pattern pattern, records::Alignment alignment) {
+    using Table = records::Table<bytes, layout>;
+    constexpr size_t fields = access == Access::HotField ? 1 : Table::num_fields;
+
+    // Setup
+    const auto num_elements = state.range(0);
+    Table table(num_elements, alignment);
+    const data_generation::Random random(data_generation::Stream::Values);
+    data_generation::parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+        for (int64_t record = begin; record < end; record++) {
+            for (size_t field = 0; field < Table::num_fields; field++) {
+                table.field(record, field) = (int32_t) random.value(record * Table::num_fields + field);
+            }
+        }
+    });
+
+    // The look-ahead prefetches read up to 2 * PREFETCH_OFFSET elements past the end so the tail is padded with zeros
+    auto *index_array = (int32_t *) malloc(sizeof(int32_t) * (num_elements + 2 * PREFETCH_OFFSET));
+    memset(&index_array[num_elements], 0, sizeof(int32_t) * 2 * PREFETCH_OFFSET);
+    datasets::indexes(pattern, num_elements, access_patterns::has_parameter(pattern) ? state.range(1) : 0)
+            ->copy_to(index_array);
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        for (int64_t x = 0; x < num_elements; x++) {
+            if constexpr (is_software_prefetching_used) {
+                table.prefetch(index_array[x + PREFETCH_OFFSET], fields);
+                __builtin_prefetch(&index_array[x + 2 * PREFETCH_OFFSET]);
+            }
+            const int32_t index = index_array[x];
+            if constexpr (access == Access::HotField) {
+                benchmark::DoNotOptimize(table.field(index, 0)++);
+            } else {
+                int32_t sum = 1;
+                for (size_t field = 1; field < fields; field++) {
+                    sum += table.field(index, field);
+                }
+                benchmark::DoNotOptimize(table.field(index, 0) += sum);
+            }
+        }
+        counters.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    state.SetItemsProcessed(num_elements * state.iterations());
+    state.counters["record_bytes"] = (double) bytes;
+    state.counters["lines_per_access"] = lines_per_access(table, num_elements, fields);
+
+    // Teardown
+    free(index_array);
+}
+
+// Provides the element count plus, for patterns that take one, every value of the pattern's parameter grid
+static void CustomArguments(benchmark::internal::Benchmark *b, access_patterns::Pattern pattern, int64_t num_elements) {
+    if (!access_patterns::has_parameter(pattern)) {
+        b->ArgNames({"elements"});
+        b->Args({num_elements});
+        return;
+    }
+    b->ArgNames({"elements", access_patterns::parameter_name(pattern)});
+    for (auto parameter : access_patterns::grid(pattern)) {
+        b->Args({num_elements, parameter});
+    }
+}
+
+template<size_t bytes, records::Layout layout, Access access, bool is_software_prefetching_used>
+static void register_variant(const char *access_name, access_patterns::Pattern pattern,
+                             records::Alignment alignment, int64_t num_elements, int64_t iterations) {
+    std::string name = std::string("BM_Records<") + std::to_string(bytes) + ", " + records::name(layout) + ", "
+                       + records::name(alignment) + ", " + access_name + ", " + access_patterns::name(pattern) + ", "
+                       + (is_software_prefetching_used ? "true" : "false") + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(),
+                                           BM_Records<bytes, layout, access, is_software_prefetching_used>,
+                                           pattern, alignment);
+    CustomArguments(b, pattern, num_elements);
+    b->Iterations(iterations);
+}
+
+template<size_t bytes, records::Layout layout>
+static void register_layout(access_patterns::Pattern pattern, records::Alignment alignment, int64_t num_elements,
+                            int64_t iterations) {
+    register_variant<bytes, layout, Access::HotField, false>("hot_field", pattern, alignment, num_elements, iterations);
+    register_variant<bytes, layout, Access::HotField, true>("hot_field", pattern, alignment, num_elements, iterations);
+    // A single field record is read whole by the hot field access already
+    if constexpr (records::Record<bytes>::num_fields > 1) {
+        register_variant<bytes, layout, Access::WholeRecord, false>("whole_record", pattern, alignment, num_elements,
+                                                                    iterations);
+        register_variant<bytes, layout, Access::WholeRecord, true>("whole_record", pattern, alignment, num_elements,
+                                                                   iterations);
+    }
+}
+
+template<size_t bytes>
+static void register_size(access_patterns::Pattern pattern, const std::vector<records::Layout> &layouts,
+                          const std::vector<records::Alignment> &alignments, int64_t num_elements,
+                          int64_t iterations) {
+    for (auto layout : layouts) {
+        for (auto alignment : alignments) {
+            // Only AoS records wider than a field can be moved across a line boundary
+            if (alignment == records::Alignment::Straddling
+                && (layout == records::Layout::SoA || records::offset(bytes, alignment) == 0)) {
+                continue;
+            }
+            if (layout == records::Layout::AoS) {
+                register_layout<bytes, records::Layout::AoS>(pattern, alignment, num_elements, iterations);
+            } else {
+                register_layout<bytes, records::Layout::SoA>(pattern, alignment, num_elements, iterations);
+            }
+        }
+    }
+}
+
+void record_layouts::register_benchmarks() {
+    const auto num_elements = options::get_int("record_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto iterations = options::get_int("record_iterations", REPETITIONS_OF_EXPERIMENTS);
+    std::vector<records::Layout> layouts;
+    for (const auto &layout_name : options::get_string_list("record_layouts", {"aos", "soa"})) {
+        records::Layout layout;
+        if (!records::from_name(layout_name, &layout)) {
+            std::cerr << "Unknown record layout: " << layout_name << std::endl;
+            continue;
+        }
+        layouts.push_back(layout);
+    }
+    std::vector<records::Alignment> alignments;
+    for (const auto &alignment_name : options::get_string_list("record_alignments", {"aligned", "straddling"})) {
+        records::Alignment alignment;
+        if (!records::from_name(alignment_name, &alignment)) {
+            std::cerr << "Unknown record alignment: " << alignment_name << std::endl;
+            continue;
+        }
+        alignments.push_back(alignment);
+    }
+
+    for (const auto &pattern_name : options::get_string_list("record_patterns", {"sequential", "shuffled"})) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        for (auto record_bytes : options::get_int_list("record_sizes", {4, 16, 64, 128, 256})) {
+            switch (record_bytes) {
+                case 4:
+                    register_size<4>(pattern, layouts, alignments, num_elements, iterations);
+                    break;
+                case 16:
+                    register_size<16>(pattern, layouts, alignments, num_elements, iterations);
+                    break;
+                case 64:
+                    register_size<64>(pattern, layouts, alignments, num_elements, iterations);
+                    break;
+                case 128:
+                    register_size<128>(pattern, layouts, alignments, num_elements, iterations);
+                    break;
+                case 256:
+                    register_size<256>(pattern, layouts, alignments, num_elements, iterations);
+                    break;
+                default:
+                    std::cerr << "Unsupported record size: " << record_bytes << std::endl;
+            }
+        }
+    }
+}
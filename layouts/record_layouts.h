@@ -0,0 +1,10 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_RECORD_LAYOUTS_H
+#define OPTIMIZATION_TESTING_GROUND_RECORD_LAYOUTS_H
+
+#include <benchmark/benchmark.h>
+
+namespace record_layouts {
+    void register_benchmarks();
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_RECORD_LAYOUTS_H
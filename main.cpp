@@ -1,11 +1,54 @@
 #include <benchmark/benchmark.h>
+#include <iostream>
+#include "common/options.h"
+#include "instrumentation/tracing.h"
 #include "clusteredness/clusteredness.h"
 #include "clusteredness/prefetching.h"
+#include "potential_optimizations/stride_guesser.h"
+#include "parallel/parallel_prefetching.h"
+#include "interleaving/interleaved_gather.h"
+#include "reordering/reordered_gather.h"
+#include "pointer_chasing/dependent_loads.h"
+#include "layouts/record_layouts.h"
+#include "measurement/ab_prefetching.h"
+#include "codegen/compiled_variants.h"
+#include "memory/out_of_core_prefetching.h"
 
 int main(int argc, char *argv[]) {
-    clusteredness::register_benchmarks();
-//    prefetching::register_benchmarks();
+    options::parse(&argc, argv);
     benchmark::Initialize(&argc, argv);
-    benchmark::RunSpecifiedBenchmarks();
-}
+    tracing::start();
 
+    // Benchmark suites to register, e.g. --suites=clusteredness,prefetching
+    for (const auto &suite : options::get_string_list("suites", {"clusteredness"})) {
+        if (suite == "clusteredness") {
+            clusteredness::register_benchmarks();
+        } else if (suite == "prefetching") {
+            prefetching::register_benchmarks();
+        } else if (suite == "stride_guesser") {
+            stride_guesser::register_benchmarks();
+        } else if (suite == "parallel_prefetching") {
+            parallel_prefetching::register_benchmarks();
+        } else if (suite == "interleaved_gather") {
+            interleaved_gather::register_benchmarks();
+        } else if (suite == "reordered_gather") {
+            reordered_gather::register_benchmarks();
+        } else if (suite == "dependent_loads") {
+            dependent_loads::register_benchmarks();
+        } else if (suite == "record_layouts") {
+            record_layouts::register_benchmarks();
+        } else if (suite == "ab_prefetching") {
+            ab_prefetching::register_benchmarks();
+        } else if (suite == "codegen") {
+            compiled_variants::register_benchmarks();
+        } else if (suite == "out_of_core") {
+            out_of_core_prefetching::register_benchmarks();
+        } else {
+            std::cerr << "Unknown benchmark suite: " << suite << std::endl;
+        }
+    }
+    // The tracing reporter names the benchmark spans and forwards to the one --benchmark_format selects
+    tracing::Reporter reporter;
+    benchmark::RunSpecifiedBenchmarks(tracing::is_recording ? &reporter : nullptr);
+    tracing::write();
+}
@@ -0,0 +1,143 @@
+#include "ab_prefetching.h"
+#include <cstdlib>
+#include <iostream>
+#include "ab_testing.h"
+#include "../access_patterns/access_patterns.h"
+#include "../common/cache.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/options.h"
+
+// Tunable parameters
+#define NUM_ELEMENTS_IN_EXPERIMENTS 16777216 // --ab_elements
+#define ROUNDS 20 // --ab_rounds, timed AB pairs after the warm up
+#define MAX_PREFETCH_DISTANCE 4096 // The largest distance --ab_distances may ask for
+
+static_assert(2 * MAX_PREFETCH_DISTANCE <= DATASET_PADDING, "The look-ahead reads past the end of the indexes");
+
+/*
+ * The BM_Prefetching kernel at two prefetch distances, measured as interleaved A/B pairs (see ab_testing.h) rather than
+ * as two benchmarks. A distance of 0 is the kernel without software prefetching, so the default pair 0:64 is
+ * BM_Prefetching<pattern, .., false> against BM_Prefetching<pattern, .., true>, and a pair like 48:64 is one of the
+ * prefetch offset tweaks whose few percent separate runs cannot resolve.
+ *
+ * Every benchmark is a single iteration running the whole protocol, its label records the core, governor and turbo
+ * state it ran under.
+ *   speedup:         time(distance_a) / time(distance_b), above 1 when distance_b is faster
+ *   ci_low, ci_high: 95% confidence interval of the speedup
+ *   significant:     1 when the interval excludes 1
+ *   a_ms, b_ms:      median time of one pass of each variant
+ */
+template<bool is_software_prefetching_used>
+static void indirect_increment(int32_t *array, const int32_t *index_array, int64_t num_elements, int64_t distance) {
+    for (int64_t x = 0; x < num_elements; x++) {
+        if constexpr (is_software_prefetching_used) {
+            __builtin_prefetch(&array[index_array[x + distance]]);
+            __builtin_prefetch(&index_array[x + 2 * distance]);
+        }
+        benchmark::DoNotOptimize(array[index_array[x]]++);
+    }
+}
+
+static std::function<void()> variant(int32_t *array, const int32_t *index_array, int64_t num_elements,
+                                     int64_t distance) {
+    if (!distance) {
+        return [=] { indirect_increment<false>(array, index_array, num_elements, 0); };
+    }
+    return [=] { indirect_increment<true>(array, index_array, num_elements, distance); };
+}
+
+static void BM_AB_Prefetching(benchmark::State &state, access_patterns::Pattern pattern, cache::State cache_state) {
+    // Setup
+    const auto num_elements = state.range(0);
+    const auto distance_a = state.range(1);
+    const auto distance_b = state.range(2);
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    datasets::values(num_elements)->copy_to(array);
+    // The indexes are only read, the shared dataset's padding holds the look-ahead of 2 * distance elements
+    const auto parameter = access_patterns::has_parameter(pattern) ? state.range(3) : 0;
+    const auto indexes = datasets::indexes(pattern, num_elements, parameter);
+    const int32_t *index_array = indexes->data();
+    const cache::Precondition precondition(cache_state, {{array, sizeof(int32_t) * num_elements},
+                                                         {index_array, sizeof(int32_t) * num_elements}});
+
+    const auto environment = ab_testing::prepare((int) options::get_int("ab_core", -1));
+    const auto rounds = (int) options::get_int("ab_rounds", ROUNDS);
+    // Each benchmark draws its own AB/BA orders, the same ones for its arguments whatever else the run contains
+    const uint64_t salt = ((uint64_t) pattern << 48) ^ ((uint64_t) distance_a << 32) ^ ((uint64_t) distance_b << 16)
+                          ^ (uint64_t) parameter;
+
+    // Actual benchmark
+    ab_testing::Result result = {};
+    for (auto _ : state) {
+        result = ab_testing::compare(variant(array, index_array, num_elements, distance_a),
+                                     variant(array, index_array, num_elements, distance_b), rounds,
+                                     [&] { precondition.apply(); }, salt);
+    }
+    data_generation::report(state);
+    state.SetLabel(environment.describe());
+    state.counters["speedup"] = result.speedup;
+    state.counters["ci_low"] = result.ci_low;
+    state.counters["ci_high"] = result.ci_high;
+    state.counters["significant"] = result.is_significant();
+    state.counters["a_ms"] = result.a_seconds * 1e3;
+    state.counters["b_ms"] = result.b_seconds * 1e3;
+    state.counters["warmup_pairs"] = result.warmup_pairs;
+
+    // Teardown
+    free(array);
+}
+
+void ab_prefetching::register_benchmarks() {
+    const auto num_elements = options::get_int("ab_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    cache::State cache_state = cache::State::Unmanaged;
+    const auto cache_state_name = options::get_string("ab_cache_state", "unmanaged");
+    if (!cache::from_name(cache_state_name, &cache_state)) {
+        std::cerr << "Unknown cache state: " << cache_state_name << std::endl;
+    }
+
+    // Pairs of distances written a:b, e.g. --ab_distances=0:64,48:64
+    std::vector<std::pair<int64_t, int64_t>> pairs;
+    for (const auto &pair : options::get_string_list("ab_distances", {"0:64"})) {
+        auto colon = pair.find(':');
+        int64_t a = -1;
+        int64_t b = -1;
+        if (colon != std::string::npos) {
+            a = std::strtoll(pair.substr(0, colon).c_str(), nullptr, 10);
+            b = std::strtoll(pair.substr(colon + 1).c_str(), nullptr, 10);
+        }
+        if (a < 0 || b < 0 || a > MAX_PREFETCH_DISTANCE || b > MAX_PREFETCH_DISTANCE) {
+            std::cerr << "Invalid A/B distance pair: " << pair << std::endl;
+            continue;
+        }
+        pairs.emplace_back(a, b);
+    }
+
+    for (const auto &pattern_name : options::get_string_list("ab_patterns", {"shuffled"})) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        std::string name = std::string("BM_AB_Prefetching<") + access_patterns::name(pattern) + ", "
+                           + cache::name(cache_state) + ">";
+        auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_AB_Prefetching, pattern, cache_state);
+        std::vector<std::string> arg_names = {"elements", "distance_a", "distance_b"};
+        std::vector<int64_t> parameters = {0};
+        if (access_patterns::has_parameter(pattern)) {
+            arg_names.emplace_back(access_patterns::parameter_name(pattern));
+            parameters = access_patterns::grid(pattern);
+        }
+        b->ArgNames(arg_names);
+        for (const auto &[distance_a, distance_b] : pairs) {
+            for (auto parameter : parameters) {
+                std::vector<int64_t> args = {num_elements, distance_a, distance_b};
+                if (access_patterns::has_parameter(pattern)) {
+                    args.push_back(parameter);
+                }
+                b->Args(args);
+            }
+        }
+        b->Iterations(1);
+    }
+}
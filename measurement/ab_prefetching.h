@@ -0,0 +1,10 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_AB_PREFETCHING_H
+#define OPTIMIZATION_TESTING_GROUND_AB_PREFETCHING_H
+
+#include <benchmark/benchmark.h>
+
+namespace ab_prefetching {
+    void register_benchmarks();
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_AB_PREFETCHING_H
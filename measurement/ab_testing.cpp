@@ -0,0 +1,155 @@
+#include "ab_testing.h"
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "../common/data_generation.h"
+
+static std::string read_line(const std::string &path) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file || !std::getline(file, line)) {
+        return "";
+    }
+    return line;
+}
+
+// intel_pstate has its own switch with the opposite sense, acpi-cpufreq and amd-pstate use cpufreq/boost
+static std::string turbo_state() {
+    auto no_turbo = read_line("/sys/devices/system/cpu/intel_pstate/no_turbo");
+    if (!no_turbo.empty()) {
+        return no_turbo == "1" ? "off" : "on";
+    }
+    auto boost = read_line("/sys/devices/system/cpu/cpufreq/boost");
+    if (!boost.empty()) {
+        return boost == "1" ? "on" : "off";
+    }
+    return "unknown";
+}
+
+std::string ab_testing::Environment::describe() const {
+    return (core >= 0 ? "core " + std::to_string(core) : std::string("unpinned")) + ", governor " + governor
+           + ", turbo " + turbo;
+}
+
+ab_testing::Environment::~Environment() {
+    if (previous_affinity) {
+        sched_setaffinity(0, sizeof(cpu_set_t), previous_affinity.get());
+    }
+}
+
+ab_testing::Environment ab_testing::prepare(int core) {
+    Environment environment;
+    if (core < 0) {
+        core = sched_getcpu();
+    }
+    auto previous_affinity = std::make_unique<cpu_set_t>();
+    const bool has_previous_affinity = sched_getaffinity(0, sizeof(cpu_set_t), previous_affinity.get()) == 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (core >= 0 && has_previous_affinity && sched_setaffinity(0, sizeof(set), &set) == 0) {
+        environment.core = core;
+        environment.previous_affinity = std::move(previous_affinity);
+    } else {
+        std::cerr << "A/B: could not pin to core " << core << ", the scheduler may migrate the runs" << std::endl;
+    }
+
+    const int cpu = std::max(core, 0);
+    environment.governor = read_line("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/scaling_governor");
+    if (environment.governor.empty()) {
+        environment.governor = "unknown";
+    } else if (environment.governor != "performance") {
+        std::cerr << "A/B: governor is " << environment.governor << ", frequency changes will add noise" << std::endl;
+    }
+    environment.turbo = turbo_state();
+    if (environment.turbo == "on") {
+        std::cerr << "A/B: turbo is on, thermal headroom will add noise" << std::endl;
+    }
+    return environment;
+}
+
+static double time_run(const std::function<void()> &run, const std::function<void()> &before_run) {
+    before_run();
+    auto start = std::chrono::steady_clock::now();
+    run();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool is_stable(const std::vector<double> &times) {
+    if (times.size() < AB_WARMUP_WINDOW) {
+        return false;
+    }
+    auto [low, high] = std::minmax_element(times.end() - AB_WARMUP_WINDOW, times.end());
+    return (*high - *low) / *low <= AB_WARMUP_TOLERANCE;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+// Two sided 95% quantile of Student's t with the given degrees of freedom
+static double t_quantile(int degrees_of_freedom) {
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degrees_of_freedom <= 30) {
+        return table[degrees_of_freedom - 1];
+    }
+    return 1.96;
+}
+
+ab_testing::Result ab_testing::compare(const std::function<void()> &a, const std::function<void()> &b, int rounds,
+                                       const std::function<void()> &before_run, uint64_t salt) {
+    Result result = {};
+    std::vector<double> a_times;
+    std::vector<double> b_times;
+    while (result.warmup_pairs < AB_WARMUP_MAX_PAIRS && !(is_stable(a_times) && is_stable(b_times))) {
+        a_times.push_back(time_run(a, before_run));
+        b_times.push_back(time_run(b, before_run));
+        result.warmup_pairs++;
+    }
+
+    const data_generation::Random order(data_generation::Stream::Schedule, salt);
+    a_times.clear();
+    b_times.clear();
+    std::vector<double> log_ratios;
+    for (int round = 0; round < rounds; round++) {
+        double a_time;
+        double b_time;
+        if (order.chance(round, 0.5)) {
+            a_time = time_run(a, before_run);
+            b_time = time_run(b, before_run);
+        } else {
+            b_time = time_run(b, before_run);
+            a_time = time_run(a, before_run);
+        }
+        a_times.push_back(a_time);
+        b_times.push_back(b_time);
+        log_ratios.push_back(std::log(a_time / b_time));
+    }
+
+    const auto n = (double) log_ratios.size();
+    double mean = 0;
+    for (auto ratio : log_ratios) {
+        mean += ratio / n;
+    }
+    double variance = 0;
+    for (auto ratio : log_ratios) {
+        variance += (ratio - mean) * (ratio - mean) / std::max(n - 1, 1.0);
+    }
+    const double half_width = rounds > 1 ? t_quantile(rounds - 1) * std::sqrt(variance / n) : 0;
+    result.speedup = std::exp(mean);
+    result.ci_low = std::exp(mean - half_width);
+    result.ci_high = std::exp(mean + half_width);
+    result.a_seconds = rounds ? median(a_times) : 0;
+    result.b_seconds = rounds ? median(b_times) : 0;
+    result.rounds = rounds;
+    return result;
+}
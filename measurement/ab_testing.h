@@ -0,0 +1,72 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_AB_TESTING_H
+#define OPTIMIZATION_TESTING_GROUND_AB_TESTING_H
+
+#include <sched.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/*
+ * Paired A/B measurement of two variants of a kernel.
+ *
+ * Running each variant as its own benchmark, one after the other, compares them at different points in time: a
+ * frequency change, another tenant or thermal drift in between shows up as a difference between the variants. Here
+ * the variants take turns instead:
+ *   1. The thread is pinned to one core for as long as the Environment lives, and the core's cpufreq governor and the turbo state are read so that a
+ *      result taken under powersave or with turbo on says so.
+ *   2. Warm up: pairs of runs until the last AB_WARMUP_WINDOW times of both variants are within AB_WARMUP_TOLERANCE
+ *      of each other (or AB_WARMUP_MAX_PAIRS pairs have run).
+ *   3. rounds pairs, each in a random order (AB or BA), so that drift hits both variants alike.
+ * Every pair gives a ratio time(A) / time(B). The speedup of B over A is the geometric mean of the ratios, with a 95%
+ * confidence interval from Student's t on their logarithms. An interval that does not contain 1 is a difference the
+ * noise of this run cannot explain.
+ */
+#define AB_WARMUP_WINDOW 5
+#define AB_WARMUP_TOLERANCE 0.02
+#define AB_WARMUP_MAX_PAIRS 50
+
+namespace ab_testing {
+    struct Environment {
+        int core = -1; // -1 when pinning failed
+        std::string governor; // "unknown" without cpufreq in sysfs
+        std::string turbo; // "on", "off" or "unknown"
+
+        Environment() = default;
+        Environment(Environment &&) = default;
+        Environment &operator=(Environment &&) = delete;
+        // Gives the thread back the affinity it had before prepare(), so that later suites can use every core again
+        ~Environment();
+
+        // e.g. "core 2, governor performance, turbo off"
+        std::string describe() const;
+
+    private:
+        friend Environment prepare(int core);
+        std::unique_ptr<cpu_set_t> previous_affinity;
+    };
+
+    // Pins the calling thread to core and reads its frequency settings, warns on stderr about noisy ones
+    Environment prepare(int core);
+
+    struct Result {
+        double speedup; // time(A) / time(B), above 1 when B is faster
+        double ci_low;
+        double ci_high;
+        double a_seconds; // median time of a run
+        double b_seconds;
+        int rounds;
+        int warmup_pairs;
+
+        bool is_significant() const {
+            return ci_low > 1 || ci_high < 1;
+        }
+    };
+
+    // before_run is called ahead of every timed run of either variant, e.g. to put the caches into a known state.
+    // salt picks the sequence of AB and BA orders, comparisons in one run should each use their own
+    Result compare(const std::function<void()> &a, const std::function<void()> &b, int rounds,
+                   const std::function<void()> &before_run = [] {}, uint64_t salt = 0);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_AB_TESTING_H
@@ -0,0 +1,195 @@
+#include "allocators.h"
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../common/options.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define SMALL_PAGE_SIZE (4UL * 1024)
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define GIGANTIC_PAGE_SIZE (1024UL * 1024 * 1024)
+#define FILE_BACKED_DIRECTORY "/var/tmp" // --file_backed_dir, on storage rather than tmpfs
+
+const std::vector<allocators::Allocator> &allocators::all() {
+    static const std::vector<Allocator> allocators = {
+            Allocator::Malloc,
+            Allocator::Populate,
+            Allocator::TransparentHuge,
+            Allocator::Hugetlb2M,
+            Allocator::Hugetlb1G,
+            Allocator::File,
+    };
+    return allocators;
+}
+
+const char *allocators::name(Allocator allocator) {
+    switch (allocator) {
+        case Allocator::Malloc:
+            return "malloc";
+        case Allocator::Populate:
+            return "populate";
+        case Allocator::TransparentHuge:
+            return "transparent_huge";
+        case Allocator::Hugetlb2M:
+            return "hugetlb_2m";
+        case Allocator::Hugetlb1G:
+            return "hugetlb_1g";
+        case Allocator::File:
+            return "file";
+    }
+    return "unknown";
+}
+
+bool allocators::from_name(const std::string &name, Allocator *allocator) {
+    for (auto candidate : all()) {
+        if (name == allocators::name(candidate)) {
+            *allocator = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t allocators::page_size(Allocator allocator) {
+    switch (allocator) {
+        case Allocator::TransparentHuge:
+        case Allocator::Hugetlb2M:
+            return HUGE_PAGE_SIZE;
+        case Allocator::Hugetlb1G:
+            return GIGANTIC_PAGE_SIZE;
+        default:
+            return SMALL_PAGE_SIZE;
+    }
+}
+
+std::vector<allocators::Allocator> allocators::selected() {
+    std::vector<Allocator> allocators;
+    for (const auto &allocator_name : options::get_string_list("allocators", {"malloc"})) {
+        Allocator allocator;
+        if (!from_name(allocator_name, &allocator)) {
+            std::cerr << "Unknown allocator: " << allocator_name << std::endl;
+            continue;
+        }
+        allocators.push_back(allocator);
+    }
+    return allocators;
+}
+
+static size_t round_up(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+static bool map(allocators::Allocation &allocation, size_t bytes, int extra_flags) {
+    void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    allocation.memory = allocation.mapping = memory;
+    allocation.mapping_bytes = bytes;
+    return true;
+}
+
+static bool map_file(allocators::Allocation &allocation, size_t bytes) {
+    std::string path = options::get_string("file_backed_dir", FILE_BACKED_DIRECTORY);
+    path += "/optimization_testing_ground.XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd == -1) {
+        return false;
+    }
+    unlink(path.c_str());
+    void *memory = MAP_FAILED;
+    if (ftruncate(fd, (off_t) bytes) == 0) {
+        memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (memory == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    allocation.memory = allocation.mapping = memory;
+    allocation.mapping_bytes = bytes;
+    allocation.fd = fd;
+    return true;
+}
+
+static bool try_allocate(allocators::Allocation &allocation, allocators::Allocator allocator, size_t bytes) {
+    using allocators::Allocator;
+    switch (allocator) {
+        case Allocator::Malloc:
+            allocation.memory = malloc(bytes);
+            return allocation.memory != nullptr;
+        case Allocator::Populate:
+            return map(allocation, round_up(bytes, SMALL_PAGE_SIZE), MAP_POPULATE);
+        case Allocator::TransparentHuge: {
+            // Over allocate by one huge page so the start can be aligned, khugepaged only backs aligned 2 MiB ranges
+            if (!map(allocation, round_up(bytes, HUGE_PAGE_SIZE) + HUGE_PAGE_SIZE, 0)) {
+                return false;
+            }
+            allocation.memory = (void *) round_up((uintptr_t) allocation.mapping, HUGE_PAGE_SIZE);
+            madvise(allocation.memory, round_up(bytes, HUGE_PAGE_SIZE), MADV_HUGEPAGE);
+            return true;
+        }
+        case Allocator::Hugetlb2M:
+            return map(allocation, round_up(bytes, HUGE_PAGE_SIZE), MAP_HUGETLB | MAP_HUGE_2MB);
+        case Allocator::Hugetlb1G:
+            return map(allocation, round_up(bytes, GIGANTIC_PAGE_SIZE), MAP_HUGETLB | MAP_HUGE_1GB);
+        case Allocator::File:
+            return map_file(allocation, round_up(bytes, SMALL_PAGE_SIZE));
+    }
+    return false;
+}
+
+static allocators::Allocator fallback(allocators::Allocator allocator) {
+    using allocators::Allocator;
+    switch (allocator) {
+        case Allocator::Hugetlb1G:
+            return Allocator::Hugetlb2M;
+        case Allocator::Hugetlb2M:
+            return Allocator::TransparentHuge;
+        default:
+            return Allocator::Malloc;
+    }
+}
+
+allocators::Allocation allocators::allocate(Allocator allocator, size_t bytes) {
+    Allocation allocation;
+    allocation.bytes = bytes;
+    allocation.requested = allocator;
+    while (true) {
+        if (try_allocate(allocation, allocator, bytes)) {
+            allocation.obtained = allocator;
+            return allocation;
+        }
+        if (allocator == Allocator::Malloc) {
+            return allocation;
+        }
+        allocator = fallback(allocator);
+    }
+}
+
+void allocators::release(Allocation &allocation) {
+    if (allocation.mapping) {
+        munmap(allocation.mapping, allocation.mapping_bytes);
+        if (allocation.fd != -1) {
+            close(allocation.fd);
+        }
+    } else {
+        free(allocation.memory);
+    }
+    allocation = Allocation();
+}
+
+void allocators::report(benchmark::State &state, const Allocation &allocation) {
+    state.counters["page_size_kib"] = (double) (page_size(allocation.obtained) / 1024);
+    state.counters["huge_page_fallback"] = allocation.obtained != allocation.requested;
+}
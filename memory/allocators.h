@@ -0,0 +1,59 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_ALLOCATORS_H
+#define OPTIMIZATION_TESTING_GROUND_ALLOCATORS_H
+
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Allocation strategies for the benchmark arrays.
+ * With 4 KiB pages every access past a modest stride is also a dTLB miss, so the page size the arrays live on decides
+ * how much of a measured miss is the page walk rather than the cache miss.
+ *
+ * Huge page requests fall back when the system cannot serve them: hugetlb_1g -> hugetlb_2m -> transparent_huge ->
+ * malloc. The strategy that was actually obtained is kept in the Allocation and reported with the results so that a
+ * silent fallback cannot be mistaken for a measurement. transparent_huge is only advice to the kernel, check
+ * AnonHugePages in /proc/meminfo when its numbers look like malloc's.
+ *
+ * file maps a file in --file_backed_dir instead of anonymous memory, so that a miss can also be a page fault into
+ * storage (see memory/out_of_core.h). The file is unlinked as soon as it is mapped and disappears with the mapping.
+ */
+namespace allocators {
+    enum class Allocator {
+        Malloc,          // Plain malloc, 4 KiB pages faulted in on first touch
+        Populate,        // mmap with MAP_POPULATE, 4 KiB pages faulted in up front
+        TransparentHuge, // 2 MiB aligned mmap with madvise(MADV_HUGEPAGE)
+        Hugetlb2M,       // MAP_HUGETLB with 2 MiB pages from the hugetlbfs pool
+        Hugetlb1G,       // MAP_HUGETLB with 1 GiB pages from the hugetlbfs pool
+        File,            // MAP_SHARED mapping of a file, 4 KiB pages read from the file on first touch
+    };
+
+    struct Allocation {
+        void *memory = nullptr;
+        size_t bytes = 0;
+        Allocator requested = Allocator::Malloc;
+        Allocator obtained = Allocator::Malloc;
+        // What has to be handed back to munmap, the start of memory may have been aligned up
+        void *mapping = nullptr;
+        size_t mapping_bytes = 0;
+        // The mapped file of File allocations, -1 otherwise
+        int fd = -1;
+    };
+
+    const std::vector<Allocator> &all();
+    const char *name(Allocator allocator);
+    bool from_name(const std::string &name, Allocator *allocator);
+    size_t page_size(Allocator allocator);
+
+    // Allocators picked with --allocators=a,b,c, malloc unless asked otherwise
+    std::vector<Allocator> selected();
+
+    Allocation allocate(Allocator allocator, size_t bytes);
+    void release(Allocation &allocation);
+
+    // Adds page_size_kib and huge_page_fallback counters describing the allocation
+    void report(benchmark::State &state, const Allocation &allocation);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_ALLOCATORS_H
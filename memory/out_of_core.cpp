@@ -0,0 +1,310 @@
+#include "out_of_core.h"
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#define PAGE_SIZE 4096UL
+#define READAHEAD_RING_ENTRIES 256 // Requests in flight at most, the thread waits for completions beyond that
+
+const std::vector<out_of_core::Strategy> &out_of_core::all() {
+    static const std::vector<Strategy> strategies = {
+            Strategy::Default,
+            Strategy::Random,
+            Strategy::Sequential,
+            Strategy::WillNeed,
+            Strategy::Readahead,
+    };
+    return strategies;
+}
+
+const char *out_of_core::name(Strategy strategy) {
+    switch (strategy) {
+        case Strategy::Default:
+            return "default";
+        case Strategy::Random:
+            return "madv_random";
+        case Strategy::Sequential:
+            return "madv_sequential";
+        case Strategy::WillNeed:
+            return "madv_willneed";
+        case Strategy::Readahead:
+            return "readahead_thread";
+    }
+    return "unknown";
+}
+
+bool out_of_core::from_name(const std::string &name, Strategy *strategy) {
+    for (auto candidate : all()) {
+        if (name == out_of_core::name(candidate)) {
+            *strategy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void out_of_core::advise(const allocators::Allocation &allocation, Strategy strategy) {
+    if (!allocation.mapping) {
+        return;
+    }
+    int advice = MADV_NORMAL;
+    if (strategy == Strategy::Random) {
+        advice = MADV_RANDOM;
+    } else if (strategy == Strategy::Sequential) {
+        advice = MADV_SEQUENTIAL;
+    }
+    madvise(allocation.mapping, allocation.mapping_bytes, advice);
+}
+
+void out_of_core::drop(const allocators::Allocation &allocation) {
+    if (allocation.fd == -1) {
+        return;
+    }
+    // Dirty pages cannot be evicted, the kernels update the arrays they read
+    msync(allocation.mapping, allocation.mapping_bytes, MS_SYNC);
+    madvise(allocation.mapping, allocation.mapping_bytes, MADV_DONTNEED);
+    posix_fadvise(allocation.fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+void out_of_core::PageAdvisor::will_need(const void *address) {
+    const uintptr_t page = (uintptr_t) address & ~(PAGE_SIZE - 1);
+    if (page != last_page) {
+        madvise((void *) page, PAGE_SIZE, MADV_WILLNEED);
+        last_page = page;
+    }
+}
+
+// Faults of the calling thread only, the helper thread of the Readahead strategy takes its faults off the critical path
+static void faults(long *minor, long *major) {
+    rusage usage = {};
+    getrusage(RUSAGE_THREAD, &usage);
+    *minor = usage.ru_minflt;
+    *major = usage.ru_majflt;
+}
+
+void out_of_core::FaultCounters::start() {
+    faults(&minor_at_start, &major_at_start);
+}
+
+void out_of_core::FaultCounters::stop() {
+    long minor_now, major_now;
+    faults(&minor_now, &major_now);
+    minor += minor_now - minor_at_start;
+    major += major_now - major_at_start;
+    passes++;
+}
+
+void out_of_core::FaultCounters::report(benchmark::State &state) {
+    if (!passes) {
+        return;
+    }
+    state.counters["minor_faults"] = (double) minor / (double) passes;
+    state.counters["major_faults"] = (double) major / (double) passes;
+}
+
+namespace {
+    // The submission and completion rings of an io_uring instance, used for IORING_OP_MADVISE requests only
+    class Ring {
+    public:
+        explicit Ring(unsigned entries) {
+            io_uring_params params = {};
+            fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+            if (fd < 0) {
+                return;
+            }
+            sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single_mapping = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_mapping) {
+                sq_bytes = cq_bytes = std::max(sq_bytes, cq_bytes);
+            }
+            sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+            sq_ring = mmap(nullptr, sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                           IORING_OFF_SQ_RING);
+            cq_ring = single_mapping ? sq_ring : mmap(nullptr, cq_bytes, PROT_READ | PROT_WRITE,
+                                                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            sqes = (io_uring_sqe *) mmap(nullptr, sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                         IORING_OFF_SQES);
+            if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+                release();
+                return;
+            }
+            auto *sq = (char *) sq_ring;
+            auto *cq = (char *) cq_ring;
+            sq_tail = (unsigned *) (sq + params.sq_off.tail);
+            sq_mask = *(unsigned *) (sq + params.sq_off.ring_mask);
+            sq_array = (unsigned *) (sq + params.sq_off.array);
+            cq_head = (unsigned *) (cq + params.cq_off.head);
+            cq_tail = (unsigned *) (cq + params.cq_off.tail);
+            capacity = params.sq_entries;
+        }
+
+        ~Ring() {
+            while (in_flight && submit(in_flight)) {
+            }
+            release();
+        }
+
+        bool is_open() const {
+            return fd >= 0;
+        }
+
+        // io_uring predates IORING_OP_MADVISE (5.6), on older kernels every request would complete with -EINVAL
+        bool supports(unsigned opcode) const {
+            if (!is_open()) {
+                return false;
+            }
+            std::vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+            auto *probe = (io_uring_probe *) buffer.data();
+            if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+                return false;
+            }
+            return opcode <= probe->last_op && opcode < probe->ops_len
+                   && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+        }
+
+        bool will_need(uintptr_t page) {
+            if (queued + in_flight == capacity && !submit(1)) {
+                return false;
+            }
+            const unsigned tail = *sq_tail;
+            const unsigned index = tail & sq_mask;
+            io_uring_sqe &sqe = sqes[index];
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_MADVISE;
+            sqe.addr = page;
+            sqe.len = PAGE_SIZE;
+            sqe.fadvise_advice = MADV_WILLNEED;
+            sq_array[index] = index;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            queued++;
+            return true;
+        }
+
+        // Submits the queued requests and waits for wait completions, false when the ring no longer works
+        bool submit(unsigned wait = 0) {
+            long submitted = syscall(__NR_io_uring_enter, fd, queued, wait, wait ? IORING_ENTER_GETEVENTS : 0,
+                                     nullptr, 0);
+            if (submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                return false;
+            }
+            submitted = std::max(submitted, 0L);
+            queued -= (unsigned) submitted;
+            in_flight += (unsigned) submitted;
+            // Only the results' arrival matters, a failed advice is a page that faults later
+            const unsigned head = *cq_head;
+            const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            in_flight -= tail - head;
+            __atomic_store_n(cq_head, tail, __ATOMIC_RELEASE);
+            return true;
+        }
+
+    private:
+        void release() {
+            if (sqes && sqes != MAP_FAILED) {
+                munmap(sqes, sqes_bytes);
+            }
+            if (cq_ring && cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+                munmap(cq_ring, cq_bytes);
+            }
+            if (sq_ring && sq_ring != MAP_FAILED) {
+                munmap(sq_ring, sq_bytes);
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;
+            in_flight = 0;
+        }
+
+        int fd = -1;
+        void *sq_ring = nullptr;
+        void *cq_ring = nullptr;
+        io_uring_sqe *sqes = nullptr;
+        size_t sq_bytes = 0;
+        size_t cq_bytes = 0;
+        size_t sqes_bytes = 0;
+        unsigned *sq_tail = nullptr;
+        unsigned sq_mask = 0;
+        unsigned *sq_array = nullptr;
+        unsigned *cq_head = nullptr;
+        unsigned *cq_tail = nullptr;
+        unsigned capacity = 0;
+        unsigned queued = 0;
+        unsigned in_flight = 0;
+    };
+}
+
+out_of_core::Readahead::Readahead(std::function<const void *(int64_t element)> address_of, int64_t num_elements,
+                                  int64_t distance)
+        : address_of(std::move(address_of)), num_elements(num_elements), distance(distance),
+          io_uring_available(Ring(1).supports(IORING_OP_MADVISE)) {
+}
+
+out_of_core::Readahead::~Readahead() {
+    stop();
+}
+
+const char *out_of_core::Readahead::mechanism() const {
+    if (!io_uring_available) {
+        return "madvise on the helper thread";
+    }
+    if (io_uring_failed.load(std::memory_order_relaxed)) {
+        return "io_uring until it failed, then madvise on the helper thread";
+    }
+    return "io_uring";
+}
+
+void out_of_core::Readahead::start() {
+    stop();
+    progress.store(0, std::memory_order_relaxed);
+    stopping.store(false, std::memory_order_relaxed);
+    thread = std::thread([this] { follow(); });
+}
+
+void out_of_core::Readahead::stop() {
+    if (thread.joinable()) {
+        stopping.store(true, std::memory_order_relaxed);
+        thread.join();
+    }
+}
+
+void out_of_core::Readahead::follow() {
+    Ring ring(io_uring_available ? READAHEAD_RING_ENTRIES : 0);
+    bool use_ring = ring.is_open();
+    uintptr_t last_page = 0;
+    int64_t next = 0;
+    while (next < num_elements && !stopping.load(std::memory_order_relaxed)) {
+        const int64_t limit = std::min(num_elements, progress.load(std::memory_order_relaxed) + distance);
+        if (next >= limit) {
+            if (use_ring) {
+                use_ring = ring.submit();
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        for (; next < limit; next++) {
+            const uintptr_t page = (uintptr_t) address_of(next) & ~(PAGE_SIZE - 1);
+            if (page == last_page) {
+                continue;
+            }
+            last_page = page;
+            if (!use_ring || !(use_ring = ring.will_need(page))) {
+                madvise((void *) page, PAGE_SIZE, MADV_WILLNEED);
+            }
+        }
+        if (use_ring) {
+            use_ring = ring.submit();
+        }
+    }
+    if (io_uring_available && !use_ring) {
+        io_uring_failed.store(true, std::memory_order_relaxed);
+    }
+}
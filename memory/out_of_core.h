@@ -0,0 +1,113 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_OUT_OF_CORE_H
+#define OPTIMIZATION_TESTING_GROUND_OUT_OF_CORE_H
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "allocators.h"
+
+/*
+ * Arrays in memory mapped files (allocators::Allocator::File) whose pages are not resident, so that a miss is a page
+ * fault into storage rather than a DRAM access. The prefetching question is the same one level down: how far ahead,
+ * and by whom, the page an access will need should be requested. The strategies:
+ *   Default:    no advice, the kernel's own readahead around every fault
+ *   Random:     MADV_RANDOM, readahead off, every fault reads a single page
+ *   Sequential: MADV_SEQUENTIAL, aggressive readahead, pages behind the access may be dropped early
+ *   WillNeed:   the kernel issues madvise(MADV_WILLNEED) for the page of the access distance elements ahead, the
+ *               analogue of __builtin_prefetch with PREFETCH_OFFSET at page granularity, a syscall per new page
+ *   Readahead:  a helper thread follows the kernel's progress and requests the pages of the next distance elements
+ *               with asynchronous IORING_OP_MADVISE through io_uring, or calls madvise itself where io_uring is not
+ *               available (ENOSYS, disabled by a seccomp profile, or a kernel before 5.6 without IORING_OP_MADVISE)
+ * The io_uring ring is driven through the raw syscalls, as perf_event_open and mbind are elsewhere, so no liburing is
+ * needed.
+ *
+ * drop() puts a mapping back into the cold state before a pass: dirty pages are written back, unmapped and evicted from
+ * the page cache. On tmpfs the page cache is the storage, --file_backed_dir should be on a disk.
+ */
+namespace out_of_core {
+    enum class Strategy {
+        Default,
+        Random,
+        Sequential,
+        WillNeed,
+        Readahead,
+    };
+
+    const std::vector<Strategy> &all();
+    const char *name(Strategy strategy);
+    bool from_name(const std::string &name, Strategy *strategy);
+
+    // Applies the madvise mode of strategy to the whole allocation, MADV_NORMAL for the ones without one
+    void advise(const allocators::Allocation &allocation, Strategy strategy);
+
+    // Writes back and evicts every page of a File allocation, does nothing for other allocations
+    void drop(const allocators::Allocation &allocation);
+
+    // madvise(MADV_WILLNEED) of the page holding address, unless it is the page requested last
+    class PageAdvisor {
+    public:
+        void will_need(const void *address);
+
+    private:
+        uintptr_t last_page = 0;
+    };
+
+    // Minor and major page faults of the calling thread, read with getrusage around every pass
+    class FaultCounters {
+    public:
+        void start();
+        void stop();
+        // Adds minor_faults and major_faults, averaged per iteration
+        void report(benchmark::State &state);
+
+    private:
+        long minor_at_start = 0;
+        long major_at_start = 0;
+        long minor = 0;
+        long major = 0;
+        int64_t passes = 0;
+    };
+
+    /*
+     * The helper thread of the Readahead strategy. address_of(i) is the address element i of the kernel accesses, the
+     * kernel calls publish(i) every so often and the thread requests the pages of the elements up to i + distance.
+     * Requests for a page already requested just before are skipped.
+     */
+    class Readahead {
+    public:
+        Readahead(std::function<const void *(int64_t element)> address_of, int64_t num_elements, int64_t distance);
+        ~Readahead();
+        Readahead(const Readahead &) = delete;
+        Readahead &operator=(const Readahead &) = delete;
+
+        // Starts following a pass over the elements from 0, call before every pass
+        void start();
+        // Waits for the thread to finish the pass
+        void stop();
+
+        void publish(int64_t element) {
+            progress.store(element, std::memory_order_relaxed);
+        }
+
+        // How the requests were made, the ring is given up for madvise when it stops working partway through a pass
+        const char *mechanism() const;
+
+    private:
+        void follow();
+
+        std::function<const void *(int64_t element)> address_of;
+        int64_t num_elements;
+        int64_t distance;
+        std::atomic<int64_t> progress{0};
+        std::atomic<bool> stopping{false};
+        bool io_uring_available;
+        std::atomic<bool> io_uring_failed{false};
+        std::thread thread;
+    };
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_OUT_OF_CORE_H
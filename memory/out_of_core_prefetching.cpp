@@ -0,0 +1,283 @@
+#include "out_of_core_prefetching.h"
+#include <algorithm>
+#include <iostream>
+#include "allocators.h"
+#include "out_of_core.h"
+#include "../access_patterns/access_patterns.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/options.h"
+#include "../instrumentation/perf_counters.h"
+
+// Tunable parameters
+#define NUM_ELEMENTS_IN_EXPERIMENTS 16777216 // --out_of_core_elements, 64 MiB of values and as much of indexes
+#define STRIDE_ACCESSES 16384 // --out_of_core_stride_accesses, accesses of one strided pass
+#define REPETITIONS_OF_EXPERIMENTS 5 // --out_of_core_iterations
+#define DROP_PAGE_CACHE true // --out_of_core_cold, evict the files from the page cache before every pass
+
+/*
+ * BM_Prefetching and BM_Large_Stride_Distance over arrays in files (see memory/out_of_core.h), with the page cache
+ * emptied before every pass so that the first access to a page is a major fault into storage. Each strategy of
+ * out_of_core::Strategy is one benchmark, distance plays the part of PREFETCH_OFFSET for the strategies that look
+ * ahead (madv_willneed and readahead_thread) and is 0 for the others.
+ *   BM_Out_Of_Core<pattern, strategy>:    array[index_array[x]]++ over the access pattern
+ *   BM_Out_Of_Core_Large_Stride<strategy>: array[x * stride]++, stride elements apart
+ *
+ * Hypothesis.
+ *   Sequential: the kernel's readahead already runs ahead of a sequential scan, MADV_SEQUENTIAL doubles its window and
+ *               MADV_RANDOM turns every page into a fault, look-ahead should add little but its syscalls.
+ *   Shuffled:   every access is to a random page, readahead reads pages that are not needed next and MADV_RANDOM
+ *               should beat the default. madvise(MADV_WILLNEED) in the loop overlaps the reads of distance pages but
+ *               pays a syscall per access, the readahead thread moves those off the critical path, with io_uring
+ *               without even blocking the helper on the reads.
+ *   Strides:    below a page the accesses are sequential in pages, at a page and above every access is a new page
+ *               and look-ahead should matter as much as it does for BM_Large_Stride_Distance in DRAM.
+ *
+ * Counters.
+ *   minor_faults, major_faults: page faults taken by the kernel per pass, a major fault waited for storage
+ *   items_per_second:           accesses per second
+ * The label of a readahead_thread benchmark says whether its requests went through io_uring.
+ */
+template<out_of_core::Strategy strategy>
+static void BM_Out_Of_Core(benchmark::State &state, access_patterns::Pattern pattern) {
+    // Setup
+    const auto num_elements = state.range(0);
+    const auto distance = state.range(1);
+    auto array_allocation = allocators::allocate(allocators::Allocator::File, sizeof(int32_t) * num_elements);
+    // The look-ahead reads up to 2 * distance elements past the end, a new file reads as zeros there
+    auto index_array_allocation = allocators::allocate(allocators::Allocator::File,
+                                                       sizeof(int32_t) * (num_elements + 2 * distance));
+    if (array_allocation.fd == -1 || index_array_allocation.fd == -1) {
+        state.SkipWithError("Could not map a file in --file_backed_dir");
+        allocators::release(index_array_allocation);
+        allocators::release(array_allocation);
+        return;
+    }
+    auto *array = (int32_t *) array_allocation.memory;
+    auto *index_array = (int32_t *) index_array_allocation.memory;
+    datasets::values(num_elements)->copy_to(array);
+    datasets::indexes(pattern, num_elements, access_patterns::has_parameter(pattern) ? state.range(2) : 0)
+            ->copy_to(index_array);
+    out_of_core::advise(array_allocation, strategy);
+    out_of_core::advise(index_array_allocation, strategy);
+    const bool drop_page_cache = options::get_bool("out_of_core_cold", DROP_PAGE_CACHE);
+    out_of_core::Readahead readahead([&](int64_t x) -> const void * {
+        return &array[index_array[x]];
+    }, num_elements, distance);
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    out_of_core::FaultCounters faults;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (drop_page_cache) {
+            out_of_core::drop(array_allocation);
+            out_of_core::drop(index_array_allocation);
+        }
+        if constexpr (strategy == out_of_core::Strategy::Readahead) {
+            readahead.start();
+        }
+        state.ResumeTiming();
+
+        faults.start();
+        counters.start();
+        out_of_core::PageAdvisor array_pages, index_pages;
+        for (int64_t x = 0; x < num_elements; x++) {
+            if constexpr (strategy == out_of_core::Strategy::WillNeed) {
+                array_pages.will_need(&array[index_array[x + distance]]);
+                index_pages.will_need(&index_array[x + 2 * distance]);
+            } else if constexpr (strategy == out_of_core::Strategy::Readahead) {
+                readahead.publish(x);
+            }
+            benchmark::DoNotOptimize(array[index_array[x]]++);
+        }
+        counters.stop();
+        faults.stop();
+
+        if constexpr (strategy == out_of_core::Strategy::Readahead) {
+            state.PauseTiming();
+            readahead.stop();
+            state.ResumeTiming();
+        }
+    }
+    counters.report(state);
+    faults.report(state);
+    data_generation::report(state);
+    state.SetItemsProcessed(num_elements * state.iterations());
+    if constexpr (strategy == out_of_core::Strategy::Readahead) {
+        state.SetLabel(readahead.mechanism());
+    }
+
+    // Teardown
+    allocators::release(index_array_allocation);
+    allocators::release(array_allocation);
+}
+
+template<out_of_core::Strategy strategy>
+static void BM_Out_Of_Core_Large_Stride(benchmark::State &state) {
+    // Setup
+    const auto accesses = state.range(0);
+    const auto stride_distance = state.range(1);
+    const auto distance = state.range(2);
+    const auto num_elements = accesses * stride_distance;
+    auto array_allocation = allocators::allocate(allocators::Allocator::File, sizeof(int32_t) * num_elements);
+    if (array_allocation.fd == -1) {
+        state.SkipWithError("Could not map a file in --file_backed_dir");
+        allocators::release(array_allocation);
+        return;
+    }
+    auto *array = (int32_t *) array_allocation.memory;
+    datasets::values(num_elements)->copy_to(array);
+    out_of_core::advise(array_allocation, strategy);
+    const bool drop_page_cache = options::get_bool("out_of_core_cold", DROP_PAGE_CACHE);
+    out_of_core::Readahead readahead([&](int64_t x) -> const void * {
+        return &array[x * stride_distance];
+    }, accesses, distance);
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    out_of_core::FaultCounters faults;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (drop_page_cache) {
+            out_of_core::drop(array_allocation);
+        }
+        if constexpr (strategy == out_of_core::Strategy::Readahead) {
+            readahead.start();
+        }
+        state.ResumeTiming();
+
+        faults.start();
+        counters.start();
+        out_of_core::PageAdvisor pages;
+        for (int64_t x = 0; x < accesses; x++) {
+            if constexpr (strategy == out_of_core::Strategy::WillNeed) {
+                pages.will_need(&array[std::min(x + distance, accesses - 1) * stride_distance]);
+            } else if constexpr (strategy == out_of_core::Strategy::Readahead) {
+                readahead.publish(x);
+            }
+            benchmark::DoNotOptimize(array[x * stride_distance]++);
+        }
+        counters.stop();
+        faults.stop();
+
+        if constexpr (strategy == out_of_core::Strategy::Readahead) {
+            state.PauseTiming();
+            readahead.stop();
+            state.ResumeTiming();
+        }
+    }
+    counters.report(state);
+    faults.report(state);
+    data_generation::report(state);
+    state.SetItemsProcessed(accesses * state.iterations());
+    if constexpr (strategy == out_of_core::Strategy::Readahead) {
+        state.SetLabel(readahead.mechanism());
+    }
+
+    // Teardown
+    allocators::release(array_allocation);
+}
+
+static bool looks_ahead(out_of_core::Strategy strategy) {
+    return strategy == out_of_core::Strategy::WillNeed || strategy == out_of_core::Strategy::Readahead;
+}
+
+template<out_of_core::Strategy strategy>
+static void register_strategy(const std::vector<access_patterns::Pattern> &patterns,
+                              const std::vector<int64_t> &distances, const std::vector<int64_t> &strides,
+                              int64_t num_elements, int64_t stride_accesses, int64_t iterations) {
+    const std::vector<int64_t> strategy_distances = looks_ahead(strategy) ? distances : std::vector<int64_t>{0};
+    if (strategy_distances.empty()) {
+        return;
+    }
+    for (auto pattern : patterns) {
+        std::string name = std::string("BM_Out_Of_Core<") + access_patterns::name(pattern) + ", "
+                           + out_of_core::name(strategy) + ">";
+        auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Out_Of_Core<strategy>, pattern);
+        std::vector<std::string> arg_names = {"elements", "distance"};
+        std::vector<int64_t> parameters = {0};
+        if (access_patterns::has_parameter(pattern)) {
+            arg_names.emplace_back(access_patterns::parameter_name(pattern));
+            parameters = access_patterns::grid(pattern);
+        }
+        b->ArgNames(arg_names);
+        for (auto distance : strategy_distances) {
+            for (auto parameter : parameters) {
+                std::vector<int64_t> args = {num_elements, distance};
+                if (access_patterns::has_parameter(pattern)) {
+                    args.push_back(parameter);
+                }
+                b->Args(args);
+            }
+        }
+        b->Iterations(iterations);
+    }
+
+    if (strides.empty()) {
+        return;
+    }
+    std::string name = std::string("BM_Out_Of_Core_Large_Stride<") + out_of_core::name(strategy) + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Out_Of_Core_Large_Stride<strategy>);
+    b->ArgNames({"accesses", "stride", "distance"});
+    for (auto stride : strides) {
+        for (auto distance : strategy_distances) {
+            b->Args({stride_accesses, stride, distance});
+        }
+    }
+    b->Iterations(iterations);
+}
+
+void out_of_core_prefetching::register_benchmarks() {
+    const auto num_elements = options::get_int("out_of_core_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto stride_accesses = options::get_int("out_of_core_stride_accesses", STRIDE_ACCESSES);
+    const auto iterations = options::get_int("out_of_core_iterations", REPETITIONS_OF_EXPERIMENTS);
+    // In elements, or accesses for the strided kernel, a shuffled access is a page of its own. The index file is sized
+    // for a look-ahead past the end, not before the start
+    const auto distances = options::get_int_list("out_of_core_distances", {16, 256}, 0);
+    // In int32_t elements: a line, a page and 4 pages apart
+    const auto strides = options::get_int_list("out_of_core_strides", {16, 1024, 4096}, 1);
+    std::vector<access_patterns::Pattern> patterns;
+    for (const auto &pattern_name : options::get_string_list("out_of_core_patterns", {"sequential", "shuffled"})) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        patterns.push_back(pattern);
+    }
+
+    std::vector<std::string> all_strategy_names;
+    for (auto strategy : out_of_core::all()) {
+        all_strategy_names.emplace_back(out_of_core::name(strategy));
+    }
+    for (const auto &strategy_name : options::get_string_list("out_of_core_strategies", all_strategy_names)) {
+        out_of_core::Strategy strategy;
+        if (!out_of_core::from_name(strategy_name, &strategy)) {
+            std::cerr << "Unknown out of core strategy: " << strategy_name << std::endl;
+            continue;
+        }
+        switch (strategy) {
+            case out_of_core::Strategy::Default:
+                register_strategy<out_of_core::Strategy::Default>(patterns, distances, strides, num_elements,
+                                                                  stride_accesses, iterations);
+                break;
+            case out_of_core::Strategy::Random:
+                register_strategy<out_of_core::Strategy::Random>(patterns, distances, strides, num_elements,
+                                                                 stride_accesses, iterations);
+                break;
+            case out_of_core::Strategy::Sequential:
+                register_strategy<out_of_core::Strategy::Sequential>(patterns, distances, strides, num_elements,
+                                                                     stride_accesses, iterations);
+                break;
+            case out_of_core::Strategy::WillNeed:
+                register_strategy<out_of_core::Strategy::WillNeed>(patterns, distances, strides, num_elements,
+                                                                   stride_accesses, iterations);
+                break;
+            case out_of_core::Strategy::Readahead:
+                register_strategy<out_of_core::Strategy::Readahead>(patterns, distances, strides, num_elements,
+                                                                    stride_accesses, iterations);
+                break;
+        }
+    }
+}
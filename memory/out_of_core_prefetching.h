@@ -0,0 +1,10 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_OUT_OF_CORE_PREFETCHING_H
+#define OPTIMIZATION_TESTING_GROUND_OUT_OF_CORE_PREFETCHING_H
+
+#include <benchmark/benchmark.h>
+
+namespace out_of_core_prefetching {
+    void register_benchmarks();
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_OUT_OF_CORE_PREFETCHING_H
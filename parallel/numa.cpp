@@ -0,0 +1,114 @@
+#include "numa.h"
+#include <algorithm>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const std::vector<numa::Placement> &numa::all_placements() {
+    static const std::vector<Placement> placements = {
+            Placement::SetupThread,
+            Placement::FirstTouch,
+            Placement::Interleaved,
+            Placement::LocalNode,
+    };
+    return placements;
+}
+
+const char *numa::name(Placement placement) {
+    switch (placement) {
+        case Placement::SetupThread:
+            return "setup_thread";
+        case Placement::FirstTouch:
+            return "first_touch";
+        case Placement::Interleaved:
+            return "interleaved";
+        case Placement::LocalNode:
+            return "local_node";
+    }
+    return "unknown";
+}
+
+bool numa::from_name(const std::string &name, Placement *placement) {
+    for (auto candidate : all_placements()) {
+        if (name == numa::name(candidate)) {
+            *placement = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+int numa::num_nodes() {
+    // The online file holds a range list such as "0" or "0-3", the last number is the highest node
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string range;
+    if (!(online >> range)) {
+        return 1;
+    }
+    auto last = range.find_last_of("-,");
+    return std::stoi(last == std::string::npos ? range : range.substr(last + 1)) + 1;
+}
+
+int numa::node_of_cpu(int cpu) {
+    for (int node = 0; node < num_nodes(); node++) {
+        if (access(("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/node" + std::to_string(node)).c_str(),
+                   F_OK) == 0) {
+            return node;
+        }
+    }
+    return 0;
+}
+
+std::vector<int> numa::allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        cpus.push_back(0);
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+bool numa::pin_current_thread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+void *numa::allocate(size_t bytes) {
+    void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? nullptr : memory;
+}
+
+void numa::release(void *memory, size_t bytes) {
+    munmap(memory, bytes);
+}
+
+static bool set_policy(void *memory, size_t bytes, int mode, unsigned long nodemask) {
+    return syscall(SYS_mbind, memory, bytes, mode, &nodemask, sizeof(nodemask) * 8, 0) == 0;
+}
+
+bool numa::interleave(void *memory, size_t bytes) {
+    int nodes = std::min(num_nodes(), (int) sizeof(unsigned long) * 8);
+    unsigned long nodemask = nodes == (int) sizeof(unsigned long) * 8 ? ~0UL : (1UL << nodes) - 1;
+    return set_policy(memory, bytes, MPOL_INTERLEAVE, nodemask);
+}
+
+bool numa::bind(void *memory, size_t bytes, int node) {
+    // The mask of set_policy is a single word, as in interleave() the nodes past it are left to first touch
+    if (node < 0 || node >= (int) sizeof(unsigned long) * 8) {
+        return false;
+    }
+    return set_policy(memory, bytes, MPOL_BIND, 1UL << node);
+}
@@ -0,0 +1,38 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_NUMA_H
+#define OPTIMIZATION_TESTING_GROUND_NUMA_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Memory placement and thread pinning for the multi threaded benchmarks.
+ * Policies are applied with the mbind syscall directly so that libnuma is not needed at build time. On a machine with a
+ * single node (or where mbind is not permitted, e.g. some containers) every placement degrades to first touch.
+ */
+namespace numa {
+    enum class Placement {
+        SetupThread, // The setup thread touches everything, what malloc + a serial fill gives you
+        FirstTouch,  // Every worker touches its own partition before the data is filled in
+        Interleaved, // Pages are interleaved across all nodes
+        LocalNode,   // Every partition is bound to the node of the CPU its worker is pinned to
+    };
+
+    const std::vector<Placement> &all_placements();
+    const char *name(Placement placement);
+    bool from_name(const std::string &name, Placement *placement);
+
+    int num_nodes();
+    int node_of_cpu(int cpu);
+    // The CPUs this process may run on, in the order workers are pinned to them
+    std::vector<int> allowed_cpus();
+    bool pin_current_thread(int cpu);
+
+    // Page aligned anonymous memory so that policies can be applied to exact ranges
+    void *allocate(size_t bytes);
+    void release(void *memory, size_t bytes);
+    bool interleave(void *memory, size_t bytes);
+    bool bind(void *memory, size_t bytes, int node);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_NUMA_H
@@ -0,0 +1,346 @@
+#include "parallel_prefetching.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "numa.h"
+#include "worker_pool.h"
+#include "../access_patterns/access_patterns.h"
+#include "../common/cache.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/options.h"
+#include "../instrumentation/perf_counters.h"
+
+// Tunable parameters
+#define PREFETCH_OFFSET 64 // Same look-ahead as BM_Prefetching in prefetching.cpp
+#define CACHE_LINE_SIZE 64
+#define PAGE_SIZE 4096
+#define NUM_ELEMENTS_IN_EXPERIMENTS 100000000 // --parallel_elements
+#define REPETITIONS_OF_EXPERIMENTS 10 // --parallel_iterations
+#define PIN_THREADS true // --parallel_pin
+#define CONSTANT_LARGE_STRIDE_DISTANCE_MAX 1024 * 2 + 3
+
+/*
+ * Multi threaded versions of BM_Prefetching and BM_Large_Stride_Distance.
+ *
+ * Hypothesis.
+ * Software prefetching hides latency by keeping more misses in flight per core. Once enough cores compete for memory
+ * bandwidth and the line fill buffers are full anyway, additional prefetches should stop helping and may even hurt.
+ *
+ * Implementation Details.
+ * The index array (or the strided positions) is split into one contiguous partition per thread, the data array is
+ * shared and updated with relaxed atomic loads and stores, which compile to plain moves but keep concurrent updates
+ * well defined. Memory is placed according to a numa::Placement before it is filled in.
+ * Wall time between releasing the workers and the last one finishing is reported as manual time.
+ * Hardware counters are opened before the workers start so they cover every thread, the kernel only folds the counts
+ * of a thread into its parent when the thread exits so they are reported after the pool has been torn down.
+ *
+ * Counters.
+ *   GB/s:                       bytes of the distinct cache lines a pass touches with its data accesses per second,
+ *                               over all threads
+ *   thread_ns_per_access_mean:  per thread latency, averaged over threads
+ *   thread_ns_per_access_max:   per thread latency of the slowest thread
+ */
+struct Partition {
+    int64_t begin;
+    int64_t end;
+};
+
+static Partition partition(int64_t num_elements, int thread, int num_threads) {
+    return {num_elements * thread / num_threads, num_elements * (thread + 1) / num_threads};
+}
+
+static inline void increment(int32_t &element) {
+    std::atomic_ref<int32_t> ref(element);
+    ref.store(ref.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Applies the placement policy to memory and faults its pages in, contents are zero afterwards
+static void place(numa::Placement placement, parallel::WorkerPool &pool, const std::vector<int> &cpus, void *memory,
+                  size_t bytes) {
+    auto page_partition = [&](int thread) {
+        auto num_pages = (int64_t) ((bytes + PAGE_SIZE - 1) / PAGE_SIZE);
+        auto pages = partition(num_pages, thread, pool.size());
+        auto begin = std::min(bytes, (size_t) pages.begin * PAGE_SIZE);
+        auto end = std::min(bytes, (size_t) pages.end * PAGE_SIZE);
+        return std::make_pair((char *) memory + begin, end - begin);
+    };
+
+    switch (placement) {
+        case numa::Placement::SetupThread:
+            memset(memory, 0, bytes);
+            return;
+        case numa::Placement::Interleaved:
+            numa::interleave(memory, bytes);
+            memset(memory, 0, bytes);
+            return;
+        case numa::Placement::LocalNode:
+            for (int thread = 0; thread < pool.size(); thread++) {
+                auto [begin, length] = page_partition(thread);
+                numa::bind(begin, length, numa::node_of_cpu(cpus[thread % cpus.size()]));
+            }
+            break;
+        case numa::Placement::FirstTouch:
+            break;
+    }
+    pool.run([&](int thread) {
+        auto [begin, length] = page_partition(thread);
+        memset(begin, 0, length);
+    });
+}
+
+// Runs one timed pass of job over the pool and records the per thread times
+template<typename Job>
+static double timed_pass(parallel::WorkerPool &pool, std::vector<double> &thread_seconds, Job &&job) {
+    auto start = std::chrono::steady_clock::now();
+    pool.run([&](int thread) {
+        auto thread_start = std::chrono::steady_clock::now();
+        job(thread);
+        thread_seconds[thread] += std::chrono::duration<double>(std::chrono::steady_clock::now() - thread_start).count();
+    });
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Cache lines of array that a pass over index_array touches, each counted once
+static int64_t lines_touched(const int32_t *index_array, int64_t num_elements) {
+    const int64_t elements_per_line = CACHE_LINE_SIZE / sizeof(int32_t);
+    std::vector<bool> touched((num_elements + elements_per_line - 1) / elements_per_line, false);
+    int64_t num_lines = 0;
+    for (int64_t x = 0; x < num_elements; x++) {
+        const int64_t line = index_array[x] / elements_per_line;
+        if (!touched[line]) {
+            touched[line] = true;
+            num_lines++;
+        }
+    }
+    return num_lines;
+}
+
+static void report(benchmark::State &state, const std::vector<double> &thread_seconds, double total_seconds,
+                   int64_t accesses_per_iteration, int64_t bytes_per_iteration) {
+    double accesses = (double) accesses_per_iteration * (double) state.iterations();
+    double accesses_per_thread = accesses / (double) thread_seconds.size();
+    double mean = 0, slowest = 0;
+    for (auto seconds : thread_seconds) {
+        mean += seconds / (double) thread_seconds.size();
+        slowest = std::max(slowest, seconds);
+    }
+    state.counters["GB/s"] = (double) bytes_per_iteration * (double) state.iterations() / total_seconds / 1e9;
+    state.counters["thread_ns_per_access_mean"] = mean * 1e9 / accesses_per_thread;
+    state.counters["thread_ns_per_access_max"] = slowest * 1e9 / accesses_per_thread;
+}
+
+template<bool is_software_prefetching_used>
+static void BM_Parallel_Prefetching(benchmark::State &state, access_patterns::Pattern pattern,
+                                    numa::Placement placement) {
+    // Setup
+    const auto num_elements = state.range(0);
+    const auto num_threads = (int) state.range(1);
+    const auto cpus = numa::allowed_cpus();
+    perf_counters::PerfCounters counters(true);
+    auto pool = std::make_unique<parallel::WorkerPool>(
+            num_threads, options::get_bool("parallel_pin", PIN_THREADS) ? cpus : std::vector<int>());
+
+    // The look-ahead prefetches read up to 2 * PREFETCH_OFFSET elements past the end so the tail is padded with zeros
+    const size_t array_bytes = sizeof(int32_t) * num_elements;
+    const size_t index_array_bytes = sizeof(int32_t) * (num_elements + 2 * PREFETCH_OFFSET);
+    auto *array = (int32_t *) numa::allocate(array_bytes);
+    auto *index_array = (int32_t *) numa::allocate(index_array_bytes);
+    if (!array || !index_array) {
+        if (array) {
+            numa::release(array, array_bytes);
+        }
+        if (index_array) {
+            numa::release(index_array, index_array_bytes);
+        }
+        state.SkipWithError("Could not allocate the benchmark arrays");
+        return;
+    }
+    place(placement, *pool, cpus, array, array_bytes);
+    place(placement, *pool, cpus, index_array, index_array_bytes);
+    datasets::values(num_elements)->copy_to(array);
+    datasets::indexes(pattern, num_elements, access_patterns::has_parameter(pattern) ? state.range(2) : 0)
+            ->copy_to(index_array);
+    // Sequential and bounded patterns share a line between several accesses
+    const int64_t bytes_per_pass = lines_touched(index_array, num_elements) * CACHE_LINE_SIZE;
+
+    std::vector<double> thread_seconds(num_threads, 0);
+    double total_seconds = 0;
+
+    // Actual benchmark
+    for (auto _ : state) {
+        counters.start();
+        double seconds = timed_pass(*pool, thread_seconds, [&](int thread) {
+            auto [begin, end] = partition(num_elements, thread, num_threads);
+            for (int64_t x = begin; x < end; x++) {
+                if constexpr (is_software_prefetching_used) {
+                    // Taken from https://www.cl.cam.ac.uk/~sa614/papers/Software-Prefetching-CGO2017.pdf
+                    __builtin_prefetch(&array[index_array[x + PREFETCH_OFFSET]]);
+                    __builtin_prefetch(&index_array[x + 2 * PREFETCH_OFFSET]);
+                }
+                increment(array[index_array[x]]);
+            }
+        });
+        counters.stop();
+        state.SetIterationTime(seconds);
+        total_seconds += seconds;
+    }
+    pool.reset();
+    counters.report(state);
+    data_generation::report(state);
+    report(state, thread_seconds, total_seconds, num_elements, bytes_per_pass);
+
+    // Teardown
+    numa::release(index_array, index_array_bytes);
+    numa::release(array, array_bytes);
+}
+
+template<bool is_software_prefetching_used>
+static void BM_Parallel_Large_Stride_Distance(benchmark::State &state, numa::Placement placement) {
+    // Setup
+    const auto num_elements_orig = state.range(0);
+    const auto stride_distance = state.range(1);
+    const auto num_threads = (int) state.range(2);
+    const auto cpus = numa::allowed_cpus();
+    perf_counters::PerfCounters counters(true);
+    auto pool = std::make_unique<parallel::WorkerPool>(
+            num_threads, options::get_bool("parallel_pin", PIN_THREADS) ? cpus : std::vector<int>());
+
+    // Make sure that we access the same number of elements in each run
+    const int64_t num_elements = num_elements_orig * stride_distance;
+    const size_t array_bytes = sizeof(int32_t) * num_elements;
+    auto *array = (int32_t *) numa::allocate(array_bytes);
+    if (!array) {
+        state.SkipWithError("Could not allocate the benchmark array");
+        return;
+    }
+    place(placement, *pool, cpus, array, array_bytes);
+    datasets::values(num_elements)->copy_to(array);
+
+    const cache::Precondition precondition(cache::State::Cold,
+                                           {{array, array_bytes, sizeof(int32_t) * (size_t) stride_distance}});
+    std::vector<double> thread_seconds(num_threads, 0);
+    double total_seconds = 0;
+
+    // Actual benchmark
+    for (auto _ : state) {
+        precondition.apply();
+        counters.start();
+        double seconds = timed_pass(*pool, thread_seconds, [&](int thread) {
+            auto [begin, end] = partition(num_elements_orig, thread, num_threads);
+            for (int64_t position = begin; position < end; position++) {
+                int64_t x = position * stride_distance;
+                if constexpr (is_software_prefetching_used) {
+                    // Taken from https://www.cl.cam.ac.uk/~sa614/papers/Software-Prefetching-CGO2017.pdf
+                    __builtin_prefetch(&array[x + (PREFETCH_OFFSET * stride_distance)]);
+                }
+                increment(array[x]);
+            }
+        });
+        counters.stop();
+        state.SetIterationTime(seconds);
+        total_seconds += seconds;
+    }
+    pool.reset();
+    counters.report(state);
+    data_generation::report(state);
+    // Strides below a cache line share lines between accesses
+    report(state, thread_seconds, total_seconds, num_elements_orig,
+           num_elements_orig * std::min((int64_t) CACHE_LINE_SIZE, (int64_t) sizeof(int32_t) * stride_distance));
+
+    // Teardown
+    numa::release(array, array_bytes);
+}
+
+// Powers of two up to the number of CPUs we may run on, plus that number itself
+static std::vector<int64_t> default_thread_counts() {
+    std::vector<int64_t> thread_counts;
+    auto num_cpus = (int64_t) numa::allowed_cpus().size();
+    for (int64_t threads = 1; threads < num_cpus; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(num_cpus);
+    return thread_counts;
+}
+
+template<bool is_software_prefetching_used>
+static void register_prefetching(access_patterns::Pattern pattern, numa::Placement placement, int64_t num_elements,
+                                 const std::vector<int64_t> &thread_counts, int64_t iterations) {
+    std::string name = std::string("BM_Parallel_Prefetching<") + access_patterns::name(pattern) + ", "
+                       + numa::name(placement) + ", " + (is_software_prefetching_used ? "true" : "false") + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Parallel_Prefetching<is_software_prefetching_used>,
+                                           pattern, placement);
+    if (access_patterns::has_parameter(pattern)) {
+        b->ArgNames({"elements", "threads", access_patterns::parameter_name(pattern)});
+        for (auto threads : thread_counts) {
+            for (auto parameter : access_patterns::grid(pattern)) {
+                b->Args({num_elements, threads, parameter});
+            }
+        }
+    } else {
+        b->ArgNames({"elements", "threads"});
+        for (auto threads : thread_counts) {
+            b->Args({num_elements, threads});
+        }
+    }
+    b->Iterations(iterations)->UseManualTime();
+}
+
+template<bool is_software_prefetching_used>
+static void register_large_stride(numa::Placement placement, const std::vector<int64_t> &thread_counts,
+                                  int64_t iterations) {
+    std::string name = std::string("BM_Parallel_Large_Stride_Distance<") + numa::name(placement) + ", "
+                       + (is_software_prefetching_used ? "true" : "false") + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(),
+                                           BM_Parallel_Large_Stride_Distance<is_software_prefetching_used>,
+                                           placement);
+    b->ArgNames({"elements", "stride", "threads"});
+    for (int x = 1; x < CONSTANT_LARGE_STRIDE_DISTANCE_MAX; x *= 2) {
+        for (auto threads : thread_counts) {
+            b->Args({100000, x, threads});
+        }
+    }
+    b->Iterations(iterations)->UseManualTime();
+}
+
+void parallel_prefetching::register_benchmarks() {
+    const auto num_elements = options::get_int("parallel_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto iterations = options::get_int("parallel_iterations", REPETITIONS_OF_EXPERIMENTS);
+    // A pass needs at least one worker
+    const auto thread_counts = options::get_int_list("parallel_threads", default_thread_counts(), 1);
+    if (thread_counts.empty()) {
+        return;
+    }
+
+    std::vector<std::string> all_placement_names;
+    for (auto placement : numa::all_placements()) {
+        all_placement_names.emplace_back(numa::name(placement));
+    }
+    std::vector<numa::Placement> placements;
+    for (const auto &placement_name : options::get_string_list("parallel_placements", all_placement_names)) {
+        numa::Placement placement;
+        if (!numa::from_name(placement_name, &placement)) {
+            std::cerr << "Unknown placement: " << placement_name << std::endl;
+            continue;
+        }
+        placements.push_back(placement);
+    }
+
+    for (const auto &pattern_name : options::get_string_list("parallel_patterns", {"shuffled"})) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        for (auto placement : placements) {
+            register_prefetching<false>(pattern, placement, num_elements, thread_counts, iterations);
+            register_prefetching<true>(pattern, placement, num_elements, thread_counts, iterations);
+        }
+    }
+    for (auto placement : placements) {
+        register_large_stride<false>(placement, thread_counts, iterations);
+        register_large_stride<true>(placement, thread_counts, iterations);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_WORKER_POOL_H
+#define OPTIMIZATION_TESTING_GROUND_WORKER_POOL_H
+
+#include <barrier>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "numa.h"
+
+/*
+ * A fixed set of worker threads that all run the same job and are released together.
+ * Threads are created once per benchmark so thread start up and pinning stay out of the measured region, run() then
+ * only costs two barrier phases.
+ */
+namespace parallel {
+    class WorkerPool {
+    public:
+        // cpus[i] is the CPU worker i is pinned to, an empty list leaves the workers to the scheduler
+        WorkerPool(int num_threads, const std::vector<int> &cpus)
+                : start(num_threads + 1), finish(num_threads + 1) {
+            for (int thread = 0; thread < num_threads; thread++) {
+                int cpu = cpus.empty() ? -1 : cpus[thread % cpus.size()];
+                workers.emplace_back([this, thread, cpu] {
+                    if (cpu >= 0) {
+                        numa::pin_current_thread(cpu);
+                    }
+                    while (true) {
+                        start.arrive_and_wait();
+                        if (stopping) {
+                            return;
+                        }
+                        job(thread);
+                        finish.arrive_and_wait();
+                    }
+                });
+            }
+        }
+
+        ~WorkerPool() {
+            stopping = true;
+            start.arrive_and_wait();
+            for (auto &worker : workers) {
+                worker.join();
+            }
+        }
+
+        // Runs job(thread) on every worker and returns once all of them are done
+        void run(const std::function<void(int)> &next_job) {
+            job = next_job;
+            start.arrive_and_wait();
+            finish.arrive_and_wait();
+        }
+
+        int size() const {
+            return (int) workers.size();
+        }
+
+    private:
+        std::barrier<> start;
+        std::barrier<> finish;
+        std::function<void(int)> job;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+    };
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_WORKER_POOL_H
@@ -0,0 +1,456 @@
+#include "dependent_loads.h"
+#include <algorithm>
+#include <iostream>
+#include "structures.h"
+#include "../common/cache.h"
+#include "../common/data_generation.h"
+#include "../common/options.h"
+#include "../instrumentation/perf_counters.h"
+#include "../interleaving/interleaving.h"
+
+// Tunable parameters
+#define NUM_ELEMENTS_IN_EXPERIMENTS 8388608 // --dependent_elements, nodes of the lists, keys of the tree and table
+#define REPETITIONS_OF_EXPERIMENTS 10 // --dependent_iterations
+#define JUMP_DISTANCE 16 // --dependent_distance, nodes a jump pointer skips, lookups the look-ahead runs ahead
+#define SLOTS_PER_LINE (64 / sizeof(pointer_chasing::HashSlot))
+
+/*
+ * Pointer chasing, where the next address comes out of the previous load (the non_predictable.next() case of
+ * stride_guesser.cpp) rather than out of an index array known in advance. See pointer_chasing/structures.h.
+ *   LinkedList: every list is walked from its head, summing the payloads, one lookup per list
+ *   BPlusTree:  point lookups of uniform random keys, root to leaf
+ *   HashTable:  point lookups of uniform random keys, probing from the key's home slot
+ *
+ * Strategies.
+ *   NoPrefetch:  one lookup after the other
+ *   JumpPointer: the list prefetches through the jump pointer of every node it visits, JUMP_DISTANCE nodes ahead.
+ *                Lookups into the tree and table are independent of each other, so the jump is to the lookup
+ *                JUMP_DISTANCE ahead instead: its home slot, or the first tree node below the levels that fit in half
+ *                of L2, found by descending the resident levels
+ *   Batched:     group_size lookups are advanced a level (a node, a probed line) at a time in lockstep, every node of
+ *                the next level is prefetched before any of them is used (group prefetching)
+ *   Interleaved: group_size lookups through interleaving::run_state_machine, a finished lookup is replaced at once
+ *
+ * Hypothesis.
+ * Jump pointers only hide latency once a list is JUMP_DISTANCE nodes in, so they help long lists and do little for
+ * short ones. The tree's look-ahead pays for descending the resident levels twice. Batched and Interleaved keep
+ * group_size misses in flight on every structure. Batched stalls on the longest lookup of its group, which matters for
+ * hash probes running past their first line but not for the lists or the tree, where all lookups of a group take the
+ * same number of steps.
+ */
+enum class Structure {
+    LinkedList,
+    BPlusTree,
+    HashTable,
+};
+
+enum class Strategy {
+    NoPrefetch,
+    JumpPointer,
+    Batched,
+    Interleaved,
+};
+
+static constexpr bool is_grouped(Strategy strategy) {
+    return strategy == Strategy::Batched || strategy == Strategy::Interleaved;
+}
+
+// Linked lists
+
+struct ListLookup {
+    const pointer_chasing::LinkedLists &lists;
+    int64_t sum;
+
+    struct State {
+        int32_t node;
+    };
+
+    inline void start(State &state, int64_t list) const {
+        state.node = lists.heads[list];
+        __builtin_prefetch(&lists.nodes[state.node]);
+    }
+
+    inline bool step(State &state) {
+        const auto &node = lists.nodes[state.node];
+        sum += node.payload;
+        state.node = node.next;
+        if (state.node == -1) {
+            return true;
+        }
+        __builtin_prefetch(&lists.nodes[state.node]);
+        return false;
+    }
+};
+
+template<Strategy strategy>
+static int64_t run_lists(const pointer_chasing::LinkedLists &lists, int group_size) {
+    const auto num_lists = (int64_t) lists.heads.size();
+    const auto &nodes = lists.nodes;
+    int64_t sum = 0;
+    if constexpr (strategy == Strategy::NoPrefetch || strategy == Strategy::JumpPointer) {
+        for (int64_t list = 0; list < num_lists; list++) {
+            for (int32_t node = lists.heads[list]; node != -1; node = nodes[node].next) {
+                if constexpr (strategy == Strategy::JumpPointer) {
+                    __builtin_prefetch(&nodes[nodes[node].jump]);
+                }
+                sum += nodes[node].payload;
+            }
+        }
+    } else if constexpr (strategy == Strategy::Batched) {
+        std::vector<int32_t> cursors(group_size);
+        for (int64_t first = 0; first < num_lists; first += group_size) {
+            const auto count = (int) std::min((int64_t) group_size, num_lists - first);
+            for (int i = 0; i < count; i++) {
+                cursors[i] = lists.heads[first + i];
+                __builtin_prefetch(&nodes[cursors[i]]);
+            }
+            // Every list has list_length nodes, so the whole group ends together
+            for (int64_t k = 0; k < lists.list_length; k++) {
+                for (int i = 0; i < count; i++) {
+                    const auto &node = nodes[cursors[i]];
+                    sum += node.payload;
+                    cursors[i] = node.next;
+                    if (cursors[i] != -1) {
+                        __builtin_prefetch(&nodes[cursors[i]]);
+                    }
+                }
+            }
+        }
+    } else {
+        ListLookup lookup = {lists, 0};
+        interleaving::run_state_machine(lookup, num_lists, group_size);
+        sum = lookup.sum;
+    }
+    return sum;
+}
+
+// B+-tree
+
+static inline int32_t descend(const pointer_chasing::BPlusTree &tree, int32_t key, int levels) {
+    int32_t node = tree.root;
+    for (int level = 0; level < levels; level++) {
+        node = tree.nodes[node].children[tree.nodes[node].rank(key)];
+    }
+    return node;
+}
+
+static inline int32_t leaf_value(const pointer_chasing::BPlusTreeNode &leaf, int32_t key) {
+    int slot = leaf.rank(key) - 1;
+    return slot >= 0 && leaf.keys[slot] == key ? leaf.values[slot] : 0;
+}
+
+struct TreeLookup {
+    const pointer_chasing::BPlusTree &tree;
+    const int32_t *keys;
+    int64_t sum;
+
+    struct State {
+        int32_t key;
+        int32_t node;
+        int level;
+    };
+
+    inline void start(State &state, int64_t lookup) const {
+        state.key = keys[lookup];
+        state.node = tree.root;
+        state.level = 1;
+        __builtin_prefetch(&tree.nodes[state.node]);
+    }
+
+    inline bool step(State &state) {
+        const auto &node = tree.nodes[state.node];
+        if (state.level == tree.height) {
+            sum += leaf_value(node, state.key);
+            return true;
+        }
+        state.node = node.children[node.rank(state.key)];
+        state.level++;
+        __builtin_prefetch(&tree.nodes[state.node]);
+        return false;
+    }
+};
+
+template<Strategy strategy>
+static int64_t run_tree(const pointer_chasing::BPlusTree &tree, const int32_t *keys, int64_t num_lookups,
+                        int group_size, int64_t distance, int resident_levels) {
+    int64_t sum = 0;
+    if constexpr (strategy == Strategy::NoPrefetch || strategy == Strategy::JumpPointer) {
+        for (int64_t x = 0; x < num_lookups; x++) {
+            if constexpr (strategy == Strategy::JumpPointer) {
+                if (resident_levels < tree.height) {
+                    __builtin_prefetch(&tree.nodes[descend(tree, keys[x + distance], resident_levels)]);
+                }
+            }
+            sum += leaf_value(tree.nodes[descend(tree, keys[x], tree.height - 1)], keys[x]);
+        }
+    } else if constexpr (strategy == Strategy::Batched) {
+        std::vector<int32_t> cursors(group_size);
+        for (int64_t first = 0; first < num_lookups; first += group_size) {
+            const auto count = (int) std::min((int64_t) group_size, num_lookups - first);
+            const int32_t *group_keys = &keys[first];
+            std::fill(cursors.begin(), cursors.begin() + count, tree.root);
+            for (int level = 1; level < tree.height; level++) {
+                for (int i = 0; i < count; i++) {
+                    const auto &node = tree.nodes[cursors[i]];
+                    cursors[i] = node.children[node.rank(group_keys[i])];
+                    __builtin_prefetch(&tree.nodes[cursors[i]]);
+                }
+            }
+            for (int i = 0; i < count; i++) {
+                sum += leaf_value(tree.nodes[cursors[i]], group_keys[i]);
+            }
+        }
+    } else {
+        TreeLookup lookup = {tree, keys, 0};
+        interleaving::run_state_machine(lookup, num_lookups, group_size);
+        sum = lookup.sum;
+    }
+    return sum;
+}
+
+// Levels from the root down whose nodes together fit in half of L2
+static int resident_levels(const pointer_chasing::BPlusTree &tree) {
+    const size_t budget = cache::topology().l2_bytes / 2;
+    size_t bytes = 0;
+    int levels = 0;
+    for (auto level_size : tree.level_sizes) {
+        bytes += level_size * sizeof(pointer_chasing::BPlusTreeNode);
+        if (bytes > budget) {
+            break;
+        }
+        levels++;
+    }
+    return levels;
+}
+
+// Hash table
+
+// Probes from slot, true once the key or an empty slot is found, false when the probe runs onto a new line
+static inline bool probe_line(const pointer_chasing::HashTable &table, int32_t key, uint64_t &slot, int64_t &sum) {
+    while (true) {
+        const auto &entry = table.slots[slot];
+        if (entry.key == key) {
+            sum += entry.value;
+            return true;
+        }
+        if (entry.key == -1) {
+            return true;
+        }
+        slot = (slot + 1) & table.mask;
+        if (slot % SLOTS_PER_LINE == 0) {
+            return false;
+        }
+    }
+}
+
+struct HashLookup {
+    const pointer_chasing::HashTable &table;
+    const int32_t *keys;
+    int64_t sum;
+
+    struct State {
+        int32_t key;
+        uint64_t slot;
+    };
+
+    inline void start(State &state, int64_t lookup) const {
+        state.key = keys[lookup];
+        state.slot = table.home(state.key);
+        __builtin_prefetch(&table.slots[state.slot]);
+    }
+
+    inline bool step(State &state) {
+        if (probe_line(table, state.key, state.slot, sum)) {
+            return true;
+        }
+        __builtin_prefetch(&table.slots[state.slot]);
+        return false;
+    }
+};
+
+template<Strategy strategy>
+static int64_t run_table(const pointer_chasing::HashTable &table, const int32_t *keys, int64_t num_lookups,
+                         int group_size, int64_t distance) {
+    int64_t sum = 0;
+    if constexpr (strategy == Strategy::NoPrefetch || strategy == Strategy::JumpPointer) {
+        for (int64_t x = 0; x < num_lookups; x++) {
+            if constexpr (strategy == Strategy::JumpPointer) {
+                __builtin_prefetch(&table.slots[table.home(keys[x + distance])]);
+            }
+            uint64_t slot = table.home(keys[x]);
+            while (!probe_line(table, keys[x], slot, sum)) {}
+        }
+    } else if constexpr (strategy == Strategy::Batched) {
+        std::vector<uint64_t> cursors(group_size);
+        std::vector<uint8_t> done(group_size);
+        for (int64_t first = 0; first < num_lookups; first += group_size) {
+            const auto count = (int) std::min((int64_t) group_size, num_lookups - first);
+            const int32_t *group_keys = &keys[first];
+            for (int i = 0; i < count; i++) {
+                cursors[i] = table.home(group_keys[i]);
+                done[i] = false;
+                __builtin_prefetch(&table.slots[cursors[i]]);
+            }
+            // A line per round, until every probe of the group has ended
+            for (int remaining = count; remaining;) {
+                for (int i = 0; i < count; i++) {
+                    if (done[i]) {
+                        continue;
+                    }
+                    if (probe_line(table, group_keys[i], cursors[i], sum)) {
+                        done[i] = true;
+                        remaining--;
+                    } else {
+                        __builtin_prefetch(&table.slots[cursors[i]]);
+                    }
+                }
+            }
+        }
+    } else {
+        HashLookup lookup = {table, keys, 0};
+        interleaving::run_state_machine(lookup, num_lookups, group_size);
+        sum = lookup.sum;
+    }
+    return sum;
+}
+
+template<Structure structure, Strategy strategy>
+static void BM_Dependent_Loads(benchmark::State &state, int64_t distance) {
+    // Setup
+    const auto num_elements = state.range(0);
+    const int argument = structure == Structure::LinkedList ? 2 : 1;
+    const auto group_size = is_grouped(strategy) ? (int) state.range(argument) : 0;
+
+    perf_counters::PerfCounters counters;
+    int64_t checksum = 0;
+    int64_t items = num_elements;
+    if constexpr (structure == Structure::LinkedList) {
+        const pointer_chasing::LinkedLists lists(num_elements, state.range(1), distance);
+        items = (int64_t) lists.nodes.size();
+
+        // Actual benchmark
+        for (auto _ : state) {
+            counters.start();
+            checksum += run_lists<strategy>(lists, group_size);
+            counters.stop();
+        }
+    } else {
+        // Lookup keys, padded for the look-ahead of the last lookups
+        std::vector<int32_t> keys(num_elements + distance, 0);
+        const data_generation::Random random(data_generation::Stream::Lookups);
+        data_generation::parallel_for(num_elements, [&](int64_t begin, int64_t end) {
+            for (int64_t x = begin; x < end; x++) {
+                keys[x] = (int32_t) random.below(x, num_elements);
+            }
+        });
+
+        if constexpr (structure == Structure::BPlusTree) {
+            const pointer_chasing::BPlusTree tree(num_elements);
+            const int levels = resident_levels(tree);
+            state.counters["height"] = tree.height;
+            state.counters["resident_levels"] = levels;
+
+            // Actual benchmark
+            for (auto _ : state) {
+                counters.start();
+                checksum += run_tree<strategy>(tree, keys.data(), num_elements, group_size, distance, levels);
+                counters.stop();
+            }
+        } else {
+            const pointer_chasing::HashTable table(num_elements);
+
+            // Actual benchmark
+            for (auto _ : state) {
+                counters.start();
+                checksum += run_table<strategy>(table, keys.data(), num_elements, group_size, distance);
+                counters.stop();
+            }
+        }
+    }
+    benchmark::DoNotOptimize(checksum);
+    counters.report(state);
+    data_generation::report(state);
+    state.SetItemsProcessed(items * state.iterations());
+}
+
+template<Structure structure, Strategy strategy>
+static void register_strategy(const char *structure_name, const char *strategy_name, int64_t num_elements,
+                              int64_t iterations, int64_t distance, const std::vector<int64_t> &linked_list_lengths,
+                              const std::vector<int64_t> &grouped_sizes) {
+    if ((structure == Structure::LinkedList && linked_list_lengths.empty())
+        || (is_grouped(strategy) && grouped_sizes.empty())) {
+        return;
+    }
+    std::string name = std::string("BM_Dependent_Loads<") + structure_name + ", " + strategy_name + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Dependent_Loads<structure, strategy>, distance);
+
+    std::vector<std::string> arg_names = {"elements"};
+    std::vector<int64_t> list_lengths = {0};
+    std::vector<int64_t> group_sizes = {0};
+    if constexpr (structure == Structure::LinkedList) {
+        arg_names.emplace_back("list_length");
+        list_lengths = linked_list_lengths;
+    }
+    if constexpr (is_grouped(strategy)) {
+        arg_names.emplace_back("group_size");
+        group_sizes = grouped_sizes;
+    }
+    b->ArgNames(arg_names);
+
+    for (auto list_length : list_lengths) {
+        for (auto group_size : group_sizes) {
+            std::vector<int64_t> args = {num_elements};
+            if constexpr (structure == Structure::LinkedList) {
+                args.push_back(list_length);
+            }
+            if constexpr (is_grouped(strategy)) {
+                args.push_back(group_size);
+            }
+            b->Args(args);
+        }
+    }
+    b->Iterations(iterations);
+}
+
+template<Structure structure>
+static void register_structure(const char *structure_name, int64_t num_elements, int64_t iterations, int64_t distance,
+                               const std::vector<int64_t> &list_lengths, const std::vector<int64_t> &group_sizes) {
+    register_strategy<structure, Strategy::NoPrefetch>(structure_name, "no_prefetch", num_elements, iterations,
+                                                       distance, list_lengths, group_sizes);
+    register_strategy<structure, Strategy::JumpPointer>(structure_name, "jump_pointer", num_elements, iterations,
+                                                        distance, list_lengths, group_sizes);
+    register_strategy<structure, Strategy::Batched>(structure_name, "batched", num_elements, iterations,
+                                                    distance, list_lengths, group_sizes);
+    register_strategy<structure, Strategy::Interleaved>(structure_name, "interleaved", num_elements, iterations,
+                                                        distance, list_lengths, group_sizes);
+}
+
+void dependent_loads::register_benchmarks() {
+    const auto num_elements = options::get_int("dependent_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto iterations = options::get_int("dependent_iterations", REPETITIONS_OF_EXPERIMENTS);
+    // Lists are cut into list_length nodes and batches advance by group_size, neither may be empty
+    const auto list_lengths = options::get_int_list("dependent_list_lengths", {64, 4096}, 1);
+    const auto group_sizes = options::get_int_list("dependent_group_sizes", {4, 8, 16, 32}, 1);
+    // The look-ahead reads keys[x + distance] and jump pointers point distance nodes further down a list
+    auto distance = options::get_int("dependent_distance", JUMP_DISTANCE);
+    if (distance < 0) {
+        std::cerr << "--dependent_distance must not be negative, using " << JUMP_DISTANCE << " instead of "
+                  << distance << std::endl;
+        distance = JUMP_DISTANCE;
+    }
+    for (const auto &structure : options::get_string_list("dependent_structures",
+                                                          {"linked_list", "b_plus_tree", "hash_table"})) {
+        if (structure == "linked_list") {
+            register_structure<Structure::LinkedList>("linked_list", num_elements, iterations, distance, list_lengths,
+                                                      group_sizes);
+        } else if (structure == "b_plus_tree") {
+            register_structure<Structure::BPlusTree>("b_plus_tree", num_elements, iterations, distance, list_lengths,
+                                                     group_sizes);
+        } else if (structure == "hash_table") {
+            register_structure<Structure::HashTable>("hash_table", num_elements, iterations, distance, list_lengths,
+                                                     group_sizes);
+        } else {
+            std::cerr << "Unknown pointer chasing structure: " << structure << std::endl;
+        }
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_DEPENDENT_LOADS_H
+#define OPTIMIZATION_TESTING_GROUND_DEPENDENT_LOADS_H
+
+#include <benchmark/benchmark.h>
+
+namespace dependent_loads {
+    void register_benchmarks();
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_DEPENDENT_LOADS_H
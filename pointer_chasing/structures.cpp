@@ -0,0 +1,96 @@
+#include "structures.h"
+#include <algorithm>
+#include <climits>
+#include "../common/data_generation.h"
+
+pointer_chasing::LinkedLists::LinkedLists(int64_t num_elements, int64_t list_length, int64_t jump_distance)
+        : list_length(list_length) {
+    const int64_t num_lists = num_elements / list_length;
+    const int64_t num_nodes = num_lists * list_length;
+    // Item k of list l lives at position[l * list_length + k]
+    std::vector<int32_t> position(num_nodes);
+    data_generation::fill_permutation(position.data(), num_nodes,
+                                      data_generation::Random(data_generation::Stream::Layout));
+    const data_generation::Random payloads(data_generation::Stream::Values);
+
+    nodes.resize(num_nodes);
+    heads.resize(num_lists);
+    data_generation::parallel_for(num_lists, [&](int64_t begin, int64_t end) {
+        for (int64_t list = begin; list < end; list++) {
+            const int32_t *items = &position[list * list_length];
+            heads[list] = items[0];
+            for (int64_t k = 0; k < list_length; k++) {
+                ListNode &node = nodes[items[k]];
+                node.next = k + 1 < list_length ? items[k + 1] : -1;
+                node.jump = items[std::min(k + jump_distance, list_length - 1)];
+                node.payload = (int32_t) payloads.value(list * list_length + k);
+                node.padding = 0;
+            }
+        }
+    });
+}
+
+pointer_chasing::BPlusTree::BPlusTree(int64_t num_elements) {
+    // Leaves first, each level is appended above the previous one until a single node is left
+    std::vector<int32_t> level;
+    std::vector<int32_t> level_keys; // smallest key under every node of the level
+    for (int64_t first = 0; first < num_elements; first += BPLUS_TREE_KEYS) {
+        BPlusTreeNode leaf = {};
+        leaf.count = (int32_t) std::min((int64_t) BPLUS_TREE_KEYS, num_elements - first);
+        for (int slot = 0; slot < BPLUS_TREE_KEYS; slot++) {
+            auto key = (int32_t) (first + slot);
+            leaf.keys[slot] = slot < leaf.count ? key : INT32_MAX;
+            leaf.values[slot] = slot < leaf.count ? value_of(key) : 0;
+        }
+        level.push_back((int32_t) nodes.size());
+        level_keys.push_back((int32_t) first);
+        nodes.push_back(leaf);
+    }
+    level_sizes.push_back((int64_t) level.size());
+
+    while (level.size() > 1) {
+        std::vector<int32_t> parents;
+        std::vector<int32_t> parent_keys;
+        for (size_t first = 0; first < level.size(); first += BPLUS_TREE_KEYS + 1) {
+            BPlusTreeNode inner = {};
+            const auto num_children = (int) std::min((size_t) BPLUS_TREE_KEYS + 1, level.size() - first);
+            inner.count = num_children - 1;
+            for (int slot = 0; slot < BPLUS_TREE_KEYS; slot++) {
+                inner.keys[slot] = slot < inner.count ? level_keys[first + slot + 1] : INT32_MAX;
+            }
+            for (int child = 0; child < num_children; child++) {
+                inner.children[child] = level[first + child];
+            }
+            parents.push_back((int32_t) nodes.size());
+            parent_keys.push_back(level_keys[first]);
+            nodes.push_back(inner);
+        }
+        level = std::move(parents);
+        level_keys = std::move(parent_keys);
+        level_sizes.push_back((int64_t) level.size());
+    }
+    root = level.empty() ? -1 : level[0];
+    height = (int) level_sizes.size();
+    std::reverse(level_sizes.begin(), level_sizes.end());
+}
+
+pointer_chasing::HashTable::HashTable(int64_t num_elements) {
+    int bits = 4;
+    while (((int64_t) 1 << bits) < 2 * num_elements) {
+        bits++;
+    }
+    slots.assign((size_t) 1 << bits, {-1, 0});
+    mask = ((uint64_t) 1 << bits) - 1;
+    shift = 64 - bits;
+
+    std::vector<int32_t> keys(num_elements);
+    data_generation::fill_permutation(keys.data(), num_elements,
+                                      data_generation::Random(data_generation::Stream::Layout, 1));
+    for (auto key : keys) {
+        uint64_t slot = home(key);
+        while (slots[slot].key != -1) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = {key, value_of(key)};
+    }
+}
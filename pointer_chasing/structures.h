@@ -0,0 +1,89 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_STRUCTURES_H
+#define OPTIMIZATION_TESTING_GROUND_STRUCTURES_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Data structures where the next address is only known once the previous load has returned.
+ * Nodes refer to each other by int32_t position rather than by pointer, like the index arrays of the other suites.
+ *
+ *   LinkedLists: num_elements nodes cut into lists of list_length, laid out in random order so every hop misses.
+ *                Every node also stores a jump pointer to the node jump_distance further down its list.
+ *   BPlusTree:   bulk loaded from the keys 0 .. num_elements - 1, one cache line per node, leaves in key order.
+ *   HashTable:   open addressing with linear probing at a load factor of at most 0.5, keys inserted in random order.
+ */
+namespace pointer_chasing {
+    struct ListNode {
+        int32_t next; // -1 at the end of a list
+        int32_t jump; // jump_distance nodes further down, or the last node of the list
+        int32_t payload;
+        int32_t padding;
+    };
+
+    struct LinkedLists {
+        std::vector<ListNode> nodes;
+        std::vector<int32_t> heads;
+        int64_t list_length;
+
+        LinkedLists(int64_t num_elements, int64_t list_length, int64_t jump_distance);
+    };
+
+#define BPLUS_TREE_KEYS 7
+
+    // Inner nodes have count + 1 children, where child i holds the keys in [keys[i - 1], keys[i])
+    // Leaves hold count keys with their value in the same slot of values, unused keys are INT32_MAX
+    struct alignas(64) BPlusTreeNode {
+        int32_t keys[BPLUS_TREE_KEYS];
+        int32_t count;
+        union {
+            int32_t children[BPLUS_TREE_KEYS + 1];
+            int32_t values[BPLUS_TREE_KEYS + 1];
+        };
+
+        // Number of keys <= key, the child to descend into (inner) or one past the key's slot (leaf)
+        inline int rank(int32_t key) const {
+            int rank = 0;
+            for (int slot = 0; slot < BPLUS_TREE_KEYS; slot++) {
+                rank += keys[slot] <= key;
+            }
+            return rank;
+        }
+    };
+
+    struct BPlusTree {
+        std::vector<BPlusTreeNode> nodes;
+        int32_t root;
+        int height; // levels including the leaves
+        std::vector<int64_t> level_sizes; // nodes per level, root first
+
+        explicit BPlusTree(int64_t num_elements);
+
+        static int32_t value_of(int32_t key) {
+            return key ^ 0x5bd1e995;
+        }
+    };
+
+    struct HashSlot {
+        int32_t key; // -1 when empty
+        int32_t value;
+    };
+
+    struct HashTable {
+        std::vector<HashSlot> slots;
+        uint64_t mask;
+        int shift;
+
+        explicit HashTable(int64_t num_elements);
+
+        inline uint64_t home(int32_t key) const {
+            return ((uint64_t) (uint32_t) key * 0x9E3779B97F4A7C15ull) >> shift;
+        }
+
+        static int32_t value_of(int32_t key) {
+            return key ^ 0x27d4eb2f;
+        }
+    };
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_STRUCTURES_H
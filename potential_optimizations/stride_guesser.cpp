@@ -2,30 +2,111 @@
 // Created by chris on 28/05/2020.
 //
 
+#include "stride_guesser.h"
+#include <iostream>
+#include "../access_patterns/access_patterns.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/options.h"
+#include "../instrumentation/perf_counters.h"
 
-/*  Stride statistics
- *  arr[x] -> x + N1
- *      |  -> X + N2
- *      |  -> X + N3
+// Tunable parameters
+#define PREFETCH_OFFSET 64 // Same look-ahead as BM_Prefetching in prefetching.cpp
+#define STRIDE_GUESSER_LOOKAHEAD 4 // --stride_guesser_lookahead
+#define NUM_ELEMENTS_IN_EXPERIMENTS 100000000 // --stride_guesser_elements
+#define REPETITIONS_OF_EXPERIMENTS 10 // --stride_guesser_iterations
+
+/*
+ * Compares the learned stride prefetcher with the two strategies BM_Prefetching has.
+ *   NoPrefetch:     array[index_array[x]]++ on its own
+ *   FixedLookahead: additionally prefetches &array[index_array[x + PREFETCH_OFFSET]], this needs the index stream to
+ *                   be known ahead of time which is not the case for non_predictable.next()
+ *   Learned:        only uses the indexes seen so far, through the StrideGuesser
+ *
+ * The patterns where this is interesting are random_walk and bounded_random_offset (RANDOM_STRIDE_FROM_PREVIOUS and
+ * RANDOM_INDEX_ARRAY_ADDITION in the original experiments), where the deltas between accesses come from a bounded
+ * distribution rather than being fully random.
+ * hit_rate is the fraction of accesses whose cache line delta was already held in the table.
  */
+enum class Strategy {
+    NoPrefetch,
+    FixedLookahead,
+    Learned,
+};
+
+template<Strategy strategy>
+static void BM_Stride_Guesser(benchmark::State &state, access_patterns::Pattern pattern) {
+    // Setup
+    auto num_elements = state.range(0);
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    datasets::values(num_elements)->copy_to(array);
+    auto *index_array = (int32_t *) calloc(num_elements + PREFETCH_OFFSET, sizeof(int32_t));
+    datasets::indexes(pattern, num_elements, access_patterns::has_parameter(pattern) ? state.range(1) : 0)
+            ->copy_to(index_array);
+
+    const int lookahead = (int) options::get_int("stride_guesser_lookahead", STRIDE_GUESSER_LOOKAHEAD);
+    stride_guesser::StrideGuesser<int32_t> guesser(array, num_elements, lookahead);
+    int64_t hits = 0;
+
+    // Actual benchmark
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        for (int64_t x = 0; x < num_elements; x++) {
+            if constexpr (strategy == Strategy::FixedLookahead) {
+                __builtin_prefetch(&array[index_array[x + PREFETCH_OFFSET]]);
+            }
+            if constexpr (strategy == Strategy::Learned) {
+                guesser.prefetch();
+            }
+            int32_t index = index_array[x];
+            if constexpr (strategy == Strategy::Learned) {
+                hits += guesser.observe(index);
+            }
+            benchmark::DoNotOptimize(array[index]++);
+        }
+        counters.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+    if constexpr (strategy == Strategy::Learned) {
+        state.counters["hit_rate"] = (double) hits / (double) (num_elements * state.iterations());
+    }
+
+    // Teardown
+    free(index_array);
+    free(array);
+}
 
-// Initial code
-int main() {
-    while (cond) {
-        int x = non_predictable.next();
-        y = array[x];
-        ...
+template<Strategy strategy>
+static void register_strategy(const char *strategy_name, access_patterns::Pattern pattern, int64_t num_elements,
+                              int64_t iterations) {
+    std::string name = std::string("BM_Stride_Guesser<") + access_patterns::name(pattern) + ", " + strategy_name + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Stride_Guesser<strategy>, pattern);
+    if (access_patterns::has_parameter(pattern)) {
+        b->ArgNames({"elements", access_patterns::parameter_name(pattern)});
+        for (auto parameter : access_patterns::grid(pattern)) {
+            b->Args({num_elements, parameter});
+        }
+    } else {
+        b->ArgNames({"elements"});
+        b->Args({num_elements});
     }
+    b->Iterations(iterations);
 }
 
-// Optimized code
-int main() {
-    while (cond) {
-        prefetch(&array[x + N1])
-        prefetch(&array[x + N2])
-        prefetch(&array[x + N3])
-        int x = non_predictable.next();
-        y = array[x];
-        ...
+void stride_guesser::register_benchmarks() {
+    const auto num_elements = options::get_int("stride_guesser_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto iterations = options::get_int("stride_guesser_iterations", REPETITIONS_OF_EXPERIMENTS);
+    for (const auto &pattern_name : options::get_string_list("stride_guesser_patterns",
+                                                             {"random_walk", "bounded_random_offset"})) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        register_strategy<Strategy::NoPrefetch>("no_prefetch", pattern, num_elements, iterations);
+        register_strategy<Strategy::FixedLookahead>("fixed_lookahead", pattern, num_elements, iterations);
+        register_strategy<Strategy::Learned>("learned", pattern, num_elements, iterations);
     }
 }
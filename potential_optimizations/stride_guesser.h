@@ -0,0 +1,156 @@
+//
+// Created by chris on 28/05/2020.
+//
+
+#ifndef OPTIMIZATION_TESTING_GROUND_STRIDE_GUESSER_H
+#define OPTIMIZATION_TESTING_GROUND_STRIDE_GUESSER_H
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * A software prefetcher that learns strides from the index stream itself.
+ *
+ * Stride statistics
+ *  arr[x] -> x + N1
+ *      |  -> X + N2
+ *      |  -> X + N3
+ *
+ * Initial code
+ *     while (cond) {
+ *         int x = non_predictable.next();
+ *         y = array[x];
+ *     }
+ *
+ * Optimized code
+ *     while (cond) {
+ *         guesser.prefetch();              // prefetch(&array[x + N1]), prefetch(&array[x + N2]), ...
+ *         int x = non_predictable.next();
+ *         guesser.observe(x);
+ *         y = array[x];
+ *     }
+ *
+ * Implementation Details.
+ * The history table is keyed by a hash of the cache line last accessed and holds the STRIDE_GUESSER_TOP_K most frequent
+ * deltas (in cache lines) seen after it, each with a small saturating confidence. A delta already in the entry gains
+ * confidence, an unseen delta takes over a slot whose confidence has reached 0, otherwise every slot decays by one.
+ * The table is STRIDE_GUESSER_TABLE_ENTRIES * 16 bytes so it stays resident in the L1 data cache.
+ *
+ * Per access overhead is bounded: observe touches one entry, prefetch issues at most STRIDE_GUESSER_TOP_K prefetches
+ * for the next access plus one per extra step of lookahead, where it follows the most confident delta of each entry.
+ */
+#define STRIDE_GUESSER_TABLE_ENTRIES_LOG2 10
+#define STRIDE_GUESSER_TABLE_ENTRIES (1 << STRIDE_GUESSER_TABLE_ENTRIES_LOG2)
+#define STRIDE_GUESSER_TOP_K 3
+#define STRIDE_GUESSER_MAX_CONFIDENCE 3
+#define STRIDE_GUESSER_CACHE_LINE_SIZE 64
+
+namespace stride_guesser {
+    template<typename T>
+    class StrideGuesser {
+    public:
+        StrideGuesser(T *array, int64_t num_elements, int lookahead)
+                : array(array), num_lines((num_elements + ELEMENTS_PER_LINE - 1) / ELEMENTS_PER_LINE),
+                  lookahead(lookahead) {
+            memset(table, 0, sizeof(table));
+        }
+
+        // Prefetches the lines predicted to follow the last observed index
+        inline void prefetch() const {
+            const Entry &entry = table[slot(previous_line)];
+            // Slots that never learned a delta hold 0, prefetching the current line again is cheaper than a branch
+            for (int k = 0; k < STRIDE_GUESSER_TOP_K; k++) {
+                prefetch_line(previous_line + entry.line_deltas[k]);
+            }
+
+            // Walk further ahead along the most confident delta of each entry
+            int64_t line = previous_line;
+            for (int step = 1; step < lookahead; step++) {
+                const Entry &current = table[slot(line)];
+                int best = most_confident(current);
+                if (!current.confidence[best]) {
+                    return;
+                }
+                line += current.line_deltas[best];
+                const Entry &next = table[slot(line)];
+                prefetch_line(line + next.line_deltas[most_confident(next)]);
+            }
+        }
+
+        // Learns the delta from the previous index, returns whether that delta had been predicted
+        // The hit path is kept free of unpredictable branches and skips the store once a delta has saturated, as the
+        // same entry is usually updated again on the next access and would otherwise chain through store forwarding
+        inline bool observe(int64_t index) {
+            int64_t line = index / ELEMENTS_PER_LINE;
+            auto delta = (int32_t) (line - previous_line);
+            Entry &entry = table[slot(previous_line)];
+            previous_line = line;
+
+            uint32_t matches = 0;
+            for (int k = 0; k < STRIDE_GUESSER_TOP_K; k++) {
+                matches |= (uint32_t) ((entry.confidence[k] != 0) & (entry.line_deltas[k] == delta)) << k;
+            }
+            if (matches) {
+                int matched = __builtin_ctz(matches);
+                if (entry.confidence[matched] < STRIDE_GUESSER_MAX_CONFIDENCE) {
+                    entry.confidence[matched]++;
+                }
+                return true;
+            }
+
+            int weakest = 0;
+            for (int k = 1; k < STRIDE_GUESSER_TOP_K; k++) {
+                weakest = entry.confidence[k] < entry.confidence[weakest] ? k : weakest;
+            }
+            if (entry.confidence[weakest] == 0) {
+                entry.line_deltas[weakest] = delta;
+                entry.confidence[weakest] = 1;
+            } else {
+                for (int k = 0; k < STRIDE_GUESSER_TOP_K; k++) {
+                    entry.confidence[k]--;
+                }
+            }
+            return false;
+        }
+
+    private:
+        static constexpr int64_t ELEMENTS_PER_LINE =
+                sizeof(T) >= STRIDE_GUESSER_CACHE_LINE_SIZE ? 1 : STRIDE_GUESSER_CACHE_LINE_SIZE / sizeof(T);
+
+        struct Entry {
+            int32_t line_deltas[STRIDE_GUESSER_TOP_K];
+            uint8_t confidence[STRIDE_GUESSER_TOP_K];
+        };
+
+        static inline uint32_t slot(int64_t line) {
+            return ((uint32_t) line * 0x9E3779B1u) >> (32 - STRIDE_GUESSER_TABLE_ENTRIES_LOG2);
+        }
+
+        static inline int most_confident(const Entry &entry) {
+            int best = 0;
+            for (int k = 1; k < STRIDE_GUESSER_TOP_K; k++) {
+                if (entry.confidence[k] > entry.confidence[best]) {
+                    best = k;
+                }
+            }
+            return best;
+        }
+
+        inline void prefetch_line(int64_t line) const {
+            if (line >= 0 && line < num_lines) {
+                __builtin_prefetch(&array[line * ELEMENTS_PER_LINE]);
+            }
+        }
+
+        Entry table[STRIDE_GUESSER_TABLE_ENTRIES];
+        T *array;
+        int64_t num_lines;
+        int64_t previous_line = 0;
+        int lookahead;
+    };
+
+    void register_benchmarks();
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_STRIDE_GUESSER_H
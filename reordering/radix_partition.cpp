@@ -0,0 +1,92 @@
+#include "radix_partition.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#define CACHE_LINE_SIZE 64
+#define PAGE_SIZE 4096
+
+const char *reordering::name(Granularity granularity) {
+    switch (granularity) {
+        case Granularity::CacheLine:
+            return "cache_line";
+        case Granularity::Page:
+            return "page";
+    }
+    return "unknown";
+}
+
+bool reordering::from_name(const std::string &name, Granularity *granularity) {
+    for (auto candidate : {Granularity::CacheLine, Granularity::Page}) {
+        if (name == reordering::name(candidate)) {
+            *granularity = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+int reordering::shift(Granularity granularity) {
+    int elements = (granularity == Granularity::Page ? PAGE_SIZE : CACHE_LINE_SIZE) / sizeof(int32_t);
+    return __builtin_ctz(elements);
+}
+
+int reordering::partition(const int32_t *index_array, int64_t num_elements, int64_t max_index,
+                          Granularity granularity, int radix_bits, int32_t *indexes, int32_t *positions) {
+    const int key_shift = shift(granularity);
+    int key_bits = 0;
+    while (((max_index - 1) >> key_shift) >> key_bits) {
+        key_bits++;
+    }
+    const int passes = key_bits ? (key_bits + radix_bits - 1) / radix_bits : 0;
+    const int64_t fanout = (int64_t) 1 << radix_bits;
+
+    // Passes alternate between the output and a scratch buffer, starting in whichever makes the last one the output
+    std::vector<int32_t> scratch_indexes(passes > 1 ? num_elements : 0);
+    std::vector<int32_t> scratch_positions(passes > 1 && positions ? num_elements : 0);
+    int32_t *index_buffers[2] = {indexes, scratch_indexes.data()};
+    int32_t *position_buffers[2] = {positions, scratch_positions.data()};
+    int target = passes % 2 == 0;
+
+    const int32_t *source_indexes = index_array;
+    const int32_t *source_positions = nullptr;
+    std::vector<int64_t> offsets(fanout);
+    for (int pass = 0; pass < passes; pass++) {
+        const int pass_shift = key_shift + pass * radix_bits;
+        const auto mask = (uint32_t) (fanout - 1);
+
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (int64_t x = 0; x < num_elements; x++) {
+            offsets[((uint32_t) source_indexes[x] >> pass_shift) & mask]++;
+        }
+        int64_t sum = 0;
+        for (auto &offset : offsets) {
+            sum += offset;
+            offset = sum - offset;
+        }
+
+        int32_t *destination_indexes = index_buffers[target];
+        int32_t *destination_positions = position_buffers[target];
+        for (int64_t x = 0; x < num_elements; x++) {
+            int64_t slot = offsets[((uint32_t) source_indexes[x] >> pass_shift) & mask]++;
+            destination_indexes[slot] = source_indexes[x];
+            if (positions) {
+                destination_positions[slot] = source_positions ? source_positions[x] : (int32_t) x;
+            }
+        }
+        source_indexes = destination_indexes;
+        source_positions = destination_positions;
+        target ^= 1;
+    }
+
+    // Already in order at this granularity, nothing to move
+    if (!passes) {
+        std::copy(index_array, index_array + num_elements, indexes);
+        if (positions) {
+            for (int64_t x = 0; x < num_elements; x++) {
+                positions[x] = (int32_t) x;
+            }
+        }
+    }
+    return passes;
+}
@@ -0,0 +1,45 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_RADIX_PARTITION_H
+#define OPTIMIZATION_TESTING_GROUND_RADIX_PARTITION_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Reorders an index stream by the cache line or page its indexes land on.
+ *
+ * The TESTING_SORTEDNESS experiments show the gather is dominated by how sorted index_array is. Rather than hope for
+ * sorted input, a stable LSD radix partition on index >> granularity makes it sorted down to the granularity, so that
+ * every line (or page) of the data array is touched in one burst and in address order, which the hardware prefetcher
+ * follows.
+ *
+ * Each pass scatters into 2^radix_bits partitions. The fanout is sized to the L1 dTLB (REORDER_DTLB_ENTRIES) so the
+ * write cursors of a pass do not miss in the TLB, the number of passes follows from the number of key bits.
+ *
+ * Order.
+ * Updates like array[i]++ commute, so the reordered stream can be used as it is. Updates that do not commute, e.g.
+ * array[i] = array[i] * 31 + x, need the original position x of every index, which is carried through the passes
+ * when positions is not null. The partition is stable, so updates to the same element stay in their original order.
+ */
+#define REORDER_DTLB_ENTRIES 64
+#define REORDER_RADIX_BITS __builtin_ctz(REORDER_DTLB_ENTRIES) // --reorder_radix_bits
+#define REORDER_MAX_RADIX_BITS 16 // 65536 partitions, far past any TLB, and 1 << radix_bits stays well defined
+
+namespace reordering {
+    enum class Granularity {
+        CacheLine,
+        Page,
+    };
+
+    const char *name(Granularity granularity);
+    bool from_name(const std::string &name, Granularity *granularity);
+
+    // log2 of the number of int32_t elements per line or page
+    int shift(Granularity granularity);
+
+    // Fills indexes (and positions when not null) with index_array partitioned by destination, returns the passes run
+    // Every index must be in [0, max_index)
+    int partition(const int32_t *index_array, int64_t num_elements, int64_t max_index, Granularity granularity,
+                  int radix_bits, int32_t *indexes, int32_t *positions);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_RADIX_PARTITION_H
@@ -0,0 +1,176 @@
+#include "reordered_gather.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include "radix_partition.h"
+#include "../access_patterns/access_patterns.h"
+#include "../common/data_generation.h"
+#include "../common/datasets.h"
+#include "../common/options.h"
+#include "../instrumentation/perf_counters.h"
+
+// Tunable parameters
+#define NUM_ELEMENTS_IN_EXPERIMENTS 100000000 // --reorder_elements
+#define REPETITIONS_OF_EXPERIMENTS 10 // --reorder_iterations
+#define BASELINE_PASSES 3 // Passes of the unordered gather timed to work out the break even point
+
+/*
+ * The indirect update of BM_Prefetching run over index_array as it is, or after reordering::partition.
+ *   Increment:      array[index_array[x]]++, order does not matter so the partitioned indexes are used directly
+ *   OrderSensitive: array[i] = array[i] * 31 + x, the original position x is carried through the partition. The
+ *                   arithmetic is unsigned, it wraps almost at once on uniform values
+ *
+ * Counters of the reordered variants.
+ *   preprocess_ms:     one partition of the index array, outside the timed loop
+ *   radix_passes:      passes the partition needed at this granularity
+ *   baseline_ms:       one pass of the update over the unordered index array
+ *   break_even_passes: passes over the data after which the partition has paid for itself, -1 if it never does
+ */
+enum class Update {
+    Increment,
+    OrderSensitive,
+};
+
+template<Update update>
+static void run_update(int32_t *array, const int32_t *indexes, const int32_t *positions, int64_t num_elements) {
+    for (int64_t x = 0; x < num_elements; x++) {
+        if constexpr (update == Update::Increment) {
+            benchmark::DoNotOptimize(array[indexes[x]]++);
+        } else {
+            int32_t position = positions ? positions[x] : (int32_t) x;
+            array[indexes[x]] = (int32_t) ((uint32_t) array[indexes[x]] * 31u + (uint32_t) position);
+        }
+    }
+}
+
+template<typename Kernel>
+static double time_pass(Kernel &&kernel) {
+    auto start = std::chrono::steady_clock::now();
+    kernel();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<Update update, bool is_reordered>
+static void BM_Reordered_Gather(benchmark::State &state, access_patterns::Pattern pattern,
+                                reordering::Granularity granularity, int radix_bits) {
+    // Setup
+    const auto num_elements = state.range(0);
+    auto *array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    auto *index_array = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+    datasets::values(num_elements)->copy_to(array);
+    datasets::indexes(pattern, num_elements, access_patterns::has_parameter(pattern) ? state.range(1) : 0)
+            ->copy_to(index_array);
+
+    int32_t *indexes = index_array;
+    int32_t *positions = nullptr;
+    double preprocess_seconds = 0;
+    int passes = 0;
+    if constexpr (is_reordered) {
+        indexes = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+        if constexpr (update == Update::OrderSensitive) {
+            positions = (int32_t *) malloc(sizeof(int32_t) * num_elements);
+        }
+        preprocess_seconds = time_pass([&] {
+            passes = reordering::partition(index_array, num_elements, num_elements, granularity, radix_bits,
+                                           indexes, positions);
+        });
+    }
+
+    // Actual benchmark
+    double measured_seconds = 0;
+    perf_counters::PerfCounters counters;
+    for (auto _ : state) {
+        counters.start();
+        measured_seconds += time_pass([&] { run_update<update>(array, indexes, positions, num_elements); });
+        counters.stop();
+    }
+    counters.report(state);
+    data_generation::report(state);
+
+    if constexpr (is_reordered) {
+        double baseline_seconds = std::numeric_limits<double>::max();
+        for (int pass = 0; pass < BASELINE_PASSES; pass++) {
+            baseline_seconds = std::min(baseline_seconds, time_pass([&] {
+                run_update<update>(array, index_array, nullptr, num_elements);
+            }));
+        }
+        double saving = baseline_seconds - measured_seconds / (double) state.iterations();
+        state.counters["preprocess_ms"] = preprocess_seconds * 1e3;
+        state.counters["radix_passes"] = passes;
+        state.counters["baseline_ms"] = baseline_seconds * 1e3;
+        state.counters["break_even_passes"] = saving > 0 ? preprocess_seconds / saving : -1;
+        free(positions);
+        free(indexes);
+    }
+
+    // Teardown
+    free(index_array);
+    free(array);
+}
+
+// Provides the element count plus, for patterns that take one, every value of the pattern's parameter grid
+static void CustomArguments(benchmark::internal::Benchmark *b, access_patterns::Pattern pattern, int64_t num_elements) {
+    if (!access_patterns::has_parameter(pattern)) {
+        b->ArgNames({"elements"});
+        b->Args({num_elements});
+        return;
+    }
+    b->ArgNames({"elements", access_patterns::parameter_name(pattern)});
+    for (auto parameter : access_patterns::grid(pattern)) {
+        b->Args({num_elements, parameter});
+    }
+}
+
+template<Update update, bool is_reordered>
+static void register_update(const char *update_name, const char *granularity_name, access_patterns::Pattern pattern,
+                            reordering::Granularity granularity, int radix_bits, int64_t num_elements,
+                            int64_t iterations) {
+    std::string name = std::string("BM_Reordered_Gather<") + access_patterns::name(pattern) + ", " + update_name
+                       + ", " + granularity_name + ">";
+    auto *b = benchmark::RegisterBenchmark(name.c_str(), BM_Reordered_Gather<update, is_reordered>, pattern,
+                                           granularity, radix_bits);
+    CustomArguments(b, pattern, num_elements);
+    b->Iterations(iterations);
+}
+
+void reordered_gather::register_benchmarks() {
+    const auto num_elements = options::get_int("reorder_elements", NUM_ELEMENTS_IN_EXPERIMENTS);
+    const auto iterations = options::get_int("reorder_iterations", REPETITIONS_OF_EXPERIMENTS);
+    std::vector<reordering::Granularity> granularities;
+    for (const auto &granularity_name : options::get_string_list("reorder_granularities", {"cache_line", "page"})) {
+        reordering::Granularity granularity;
+        if (!reordering::from_name(granularity_name, &granularity)) {
+            std::cerr << "Unknown reordering granularity: " << granularity_name << std::endl;
+            continue;
+        }
+        granularities.push_back(granularity);
+    }
+    auto radix_bits = (int) options::get_int("reorder_radix_bits", REORDER_RADIX_BITS);
+    if (radix_bits < 1 || radix_bits > REORDER_MAX_RADIX_BITS) {
+        std::cerr << "--reorder_radix_bits must be in [1, " << REORDER_MAX_RADIX_BITS << "], using "
+                  << REORDER_RADIX_BITS << " instead of " << radix_bits << std::endl;
+        radix_bits = REORDER_RADIX_BITS;
+    }
+
+    for (const auto &pattern_name : options::get_string_list("reorder_patterns", {"shuffled", "partially_sorted"})) {
+        access_patterns::Pattern pattern;
+        if (!access_patterns::from_name(pattern_name, &pattern)) {
+            std::cerr << "Unknown access pattern: " << pattern_name << std::endl;
+            continue;
+        }
+        // The unordered baselines, then every granularity
+        register_update<Update::Increment, false>("increment", "unordered", pattern,
+                                                  reordering::Granularity::CacheLine, radix_bits, num_elements,
+                                                  iterations);
+        register_update<Update::OrderSensitive, false>("order_sensitive", "unordered", pattern,
+                                                       reordering::Granularity::CacheLine, radix_bits, num_elements,
+                                                       iterations);
+        for (auto granularity : granularities) {
+            register_update<Update::Increment, true>("increment", reordering::name(granularity), pattern, granularity,
+                                                     radix_bits, num_elements, iterations);
+            register_update<Update::OrderSensitive, true>("order_sensitive", reordering::name(granularity), pattern,
+                                                          granularity, radix_bits, num_elements, iterations);
+        }
+    }
+}
@@ -0,0 +1,147 @@
+#include "gather.h"
+#include <immintrin.h>
+
+#define CACHE_LINE_INDEXES 16 // int32_t indexes per cache line of the index array
+
+static inline void prefetch_ahead(const int32_t *array, const int32_t *index_array, int64_t x, int64_t lanes,
+                                  int64_t prefetch_distance) {
+    for (int64_t lane = 0; lane < lanes; lane++) {
+        __builtin_prefetch(&array[index_array[x + prefetch_distance + lane]]);
+    }
+    if (x % CACHE_LINE_INDEXES == 0) {
+        __builtin_prefetch(&index_array[x + 2 * prefetch_distance]);
+    }
+}
+
+static inline void scalar_increment(int32_t *array, const int32_t *index_array, int64_t begin, int64_t end) {
+    for (int64_t x = begin; x < end; x++) {
+        array[index_array[x]]++;
+    }
+}
+
+static int64_t increment_scalar(int32_t *array, const int32_t *index_array, int64_t num_elements,
+                                int64_t prefetch_distance) {
+    for (int64_t x = 0; x < num_elements; x++) {
+        if (prefetch_distance) {
+            __builtin_prefetch(&array[index_array[x + prefetch_distance]]);
+            __builtin_prefetch(&index_array[x + 2 * prefetch_distance]);
+        }
+        array[index_array[x]]++;
+    }
+    return 0;
+}
+
+__attribute__((target("avx2")))
+static int64_t increment_avx2(int32_t *array, const int32_t *index_array, int64_t num_elements,
+                              int64_t prefetch_distance) {
+    const __m256i ones = _mm256_set1_epi32(1);
+    int64_t conflicts = 0;
+    int64_t x = 0;
+    for (; x + 8 <= num_elements; x += 8) {
+        if (prefetch_distance) {
+            prefetch_ahead(array, index_array, x, 8, prefetch_distance);
+        }
+        __m256i indexes = _mm256_loadu_si256((const __m256i *) &index_array[x]);
+
+        // Comparing against the rotations by 1..4 lanes covers every pair of lanes
+        __m256i duplicates = _mm256_setzero_si256();
+        for (int rotation = 1; rotation <= 4; rotation++) {
+            __m256i rotate = _mm256_setr_epi32(rotation, rotation + 1, rotation + 2, rotation + 3, rotation + 4,
+                                               rotation + 5, rotation + 6, rotation + 7);
+            rotate = _mm256_and_si256(rotate, _mm256_set1_epi32(7));
+            duplicates = _mm256_or_si256(duplicates,
+                                         _mm256_cmpeq_epi32(indexes, _mm256_permutevar8x32_epi32(indexes, rotate)));
+        }
+        if (!_mm256_testz_si256(duplicates, duplicates)) {
+            scalar_increment(array, index_array, x, x + 8);
+            conflicts++;
+            continue;
+        }
+
+        __m256i values = _mm256_add_epi32(_mm256_i32gather_epi32(array, indexes, 4), ones);
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256((__m256i *) lanes, values);
+        for (int lane = 0; lane < 8; lane++) {
+            array[index_array[x + lane]] = lanes[lane];
+        }
+    }
+    scalar_increment(array, index_array, x, num_elements);
+    return conflicts;
+}
+
+__attribute__((target("avx512f,avx512cd")))
+static int64_t increment_avx512(int32_t *array, const int32_t *index_array, int64_t num_elements,
+                                int64_t prefetch_distance) {
+    const __m512i ones = _mm512_set1_epi32(1);
+    int64_t conflicts = 0;
+    int64_t x = 0;
+    for (; x + 16 <= num_elements; x += 16) {
+        if (prefetch_distance) {
+            prefetch_ahead(array, index_array, x, 16, prefetch_distance);
+        }
+        __m512i indexes = _mm512_loadu_si512((const void *) &index_array[x]);
+
+        // Every lane gets a bit for each earlier lane holding the same index
+        if (_mm512_test_epi32_mask(_mm512_conflict_epi32(indexes), _mm512_conflict_epi32(indexes))) {
+            scalar_increment(array, index_array, x, x + 16);
+            conflicts++;
+            continue;
+        }
+
+        __m512i values = _mm512_add_epi32(_mm512_i32gather_epi32(indexes, array, 4), ones);
+        _mm512_i32scatter_epi32(array, indexes, values, 4);
+    }
+    scalar_increment(array, index_array, x, num_elements);
+    return conflicts;
+}
+
+const char *simd_gather::name(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar:
+            return "scalar";
+        case Isa::Avx2:
+            return "avx2";
+        case Isa::Avx512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+bool simd_gather::from_name(const std::string &name, Isa *isa) {
+    for (auto candidate : {Isa::Scalar, Isa::Avx2, Isa::Avx512}) {
+        if (name == simd_gather::name(candidate)) {
+            *isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool simd_gather::supported(Isa isa) {
+    switch (isa) {
+        case Isa::Avx2:
+            return __builtin_cpu_supports("avx2");
+        case Isa::Avx512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd");
+        default:
+            return true;
+    }
+}
+
+simd_gather::Kernel simd_gather::select(Isa requested, Isa *selected) {
+    if (requested == Isa::Avx512 && !supported(Isa::Avx512)) {
+        requested = Isa::Avx2;
+    }
+    if (requested == Isa::Avx2 && !supported(Isa::Avx2)) {
+        requested = Isa::Scalar;
+    }
+    *selected = requested;
+    switch (requested) {
+        case Isa::Avx2:
+            return increment_avx2;
+        case Isa::Avx512:
+            return increment_avx512;
+        default:
+            return increment_scalar;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef OPTIMIZATION_TESTING_GROUND_GATHER_H
+#define OPTIMIZATION_TESTING_GROUND_GATHER_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Vectorised versions of the indirect read-modify-write loop of BM_Prefetching
+ *     for (x = 0; x < num_elements; x++) array[index_array[x]]++;
+ *
+ *   Scalar: the loop above
+ *   Avx2:   8 indexes per vpgatherdd, the incremented values are written back lane by lane as AVX2 has no scatter
+ *   Avx512: 16 indexes per gather and per scatter
+ * Two lanes holding the same index would both write back their old value + 1 and lose an increment, so every vector
+ * is checked for duplicate indexes first (vpconflictd on AVX-512, comparisons against rotations of the vector on
+ * AVX2). A vector with duplicates is updated by the scalar loop instead, the kernels return how many were.
+ *
+ * With a non zero prefetch_distance the same prefetches as BM_Prefetching are issued: &array[index_array[x + d]] for
+ * every element and the index array 2 * d ahead, once per cache line of it.
+ * index_array must be readable up to prefetch_distance + 16 elements past num_elements.
+ */
+namespace simd_gather {
+    enum class Isa {
+        Scalar,
+        Avx2,
+        Avx512,
+    };
+
+    const char *name(Isa isa);
+    bool from_name(const std::string &name, Isa *isa);
+    bool supported(Isa isa);
+
+    // Returns the number of vectors that had to be updated by the scalar loop
+    using Kernel = int64_t (*)(int32_t *array, const int32_t *index_array, int64_t num_elements,
+                               int64_t prefetch_distance);
+
+    // The kernel for the requested ISA, or for the best one below it this CPU supports (down to Scalar)
+    Kernel select(Isa requested, Isa *selected);
+};
+
+#endif //OPTIMIZATION_TESTING_GROUND_GATHER_H